@@ -20,6 +20,8 @@
 #define _RANDOM_NUMBER_GENERATOR_H_
 
 #include <vnl/vnl_random.h>
+#include <stdint.h>
+#include <math.h>
 
 /**
  * Random number generator, uniform and normal distributions.
@@ -67,4 +69,100 @@ private:
   vnl_random * generator;
 };
 
+
+/**
+ * Counter based random number generator, uniform and normal distributions.
+ * The n'th number of a stream is the SplitMix64 hash of a key derived from
+ * (seed, stream) and the counter n. There is no shared state, so every thread
+ * can own a generator, and a stream can be (re)positioned in constant time,
+ * e.g. one stream per RANSAC hypothesis so that the drawn samples do not
+ * depend on how the hypotheses are scheduled on the threads.
+ * The object is small, has no virtual methods and never allocates memory.
+ */
+class CounterBasedRandomNumberGenerator
+{
+public:
+  CounterBasedRandomNumberGenerator(uint64_t seed = 0, uint64_t stream = 0) { reset(seed, stream); }
+
+
+  /**
+   * Restart the generator at the beginning of the given stream.
+   * @param seed User seed, equal seeds and streams give equal sequences.
+   * @param stream Identifier of the stream within the seed.
+   */
+  void
+  reset(uint64_t seed, uint64_t stream)
+  {
+    key = mix(seed ^ mix(stream + goldenGamma));
+    counter = 0;
+  }
+
+  /** Get a random 64 bit integer uniformly distributed in [0, 2^64). */
+  uint64_t
+  next()
+  {
+    return mix(key + (++counter) * goldenGamma);
+  }
+
+  /**
+   * Get a random integer uniformly distributed in [0,n) (Lemire's
+   * multiply-shift with rejection, no modulo bias).
+   * @param n Upper bound, must be positive.
+   */
+  uint32_t
+  uniformInteger(uint32_t n)
+  {
+    uint64_t product = (next() >> 32) * n;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < n)
+    {
+      uint32_t threshold = static_cast<uint32_t>(-n) % n;
+      while (low < threshold)
+      {
+        product = (next() >> 32) * n;
+        low = static_cast<uint32_t>(product);
+      }
+    }
+    return static_cast<uint32_t>(product >> 32);
+  }
+
+  /**
+   * Get a random number uniformly distributed in [a,b).
+   * @param a Lower bound for random numbers, default is 0.0.
+   * @param b Upper bound for random numbers, default is 1.0.
+   */
+  double
+  uniform(double a = 0.0, double b = 1.0)
+  {
+    return a + (b - a) * (static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0));
+  }
+
+  /**
+   * Get a random number normally distributed with given mean and standard deviation.
+   * @param sigma Normal distributions standard deviation, default is one.
+   * @param mu Normal distribution's mean, default is zero.
+   */
+  double
+  normal(double sigma = 1.0, double mu = 0.0)
+  {
+    // Box-Muller, 1-uniform() is in (0,1] so the logarithm is finite
+    double radius = sqrt(-2.0 * log(1.0 - uniform()));
+    return sigma * radius * cos(6.283185307179586 * uniform()) + mu;
+  }
+
+private:
+  static uint64_t
+  mix(uint64_t z)
+  {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  static constexpr uint64_t goldenGamma = 0x9E3779B97F4A7C15ULL;
+
+  uint64_t key;
+  uint64_t counter;
+};
+
 #endif //_RANDOM_NUMBER_GENERATOR_H_
\ No newline at end of file
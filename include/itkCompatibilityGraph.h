@@ -0,0 +1,316 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkCompatibilityGraph_h
+#define itkCompatibilityGraph_h
+
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <stdint.h>
+#include "itkMultiThreaderBase.h"
+#include "itkMacro.h"
+
+namespace itk
+{
+
+/** \class CompatibilityGraph
+ *
+ * \brief Pairwise compatibility of point correspondences and a large clique
+ * of it.
+ *
+ * Vertex i is the correspondence of the fixed point points[i*stride+0..2]
+ * with the moving point points[i*stride+3..5]. Two correspondences are
+ * compatible if the distance between their fixed points and the one between
+ * their moving points agree up to the edge length ratio r, min(ds, dt) >= r
+ * max(ds, dt), the test of CheckCorresspondenceEdgeLength. A similarity
+ * keeps the ratio of the two distances constant and a rigid motion keeps it
+ * 1, so the correct matches form a clique while random ones are compatible
+ * with few others (Yang, Shi and Carlone, "TEASER: Fast and Certifiable
+ * Point Cloud Registration", T-RO 2020).
+ *
+ * The graph is stored in compressed sparse row form, the neighbours of
+ * vertex i are adjacency[offsets[i] .. offsets[i+1]) in ascending order.
+ * The rows are computed in parallel, a row is one pass over the coordinates
+ * stored as structure of arrays and writes a byte mask, a loop the compiler
+ * vectorizes.
+ *
+ *  \ingroup Ransac
+ */
+class CompatibilityGraph
+{
+public:
+  /**
+   * Build the graph, replacing any previous one.
+   * @param points First coordinate of the first correspondence.
+   * @param stride Distance between consecutive correspondences, in elements.
+   * @param numberOfVertices Number of correspondences.
+   * @param ratio Edge length ratio in (0,1].
+   * @param threader Threader the rows are computed with.
+   */
+  void
+  Build(const double * points, size_t stride, size_t numberOfVertices, double ratio, MultiThreaderBase * threader)
+  {
+    if (!(ratio > 0.0 && ratio <= 1.0))
+      throw ExceptionObject(__FILE__, __LINE__, "The edge length ratio must be in (0,1].");
+    if (numberOfVertices > static_cast<size_t>(std::numeric_limits<uint32_t>::max()))
+      throw ExceptionObject(__FILE__, __LINE__, "Too many correspondences for the compatibility graph.");
+
+    const size_t n = numberOfVertices;
+    for (unsigned int k = 0; k < 6; ++k)
+    {
+      this->coordinates[k].resize(n);
+      for (size_t i = 0; i < n; ++i)
+        this->coordinates[k][i] = points[i * stride + k];
+    }
+
+    // rows of a block are kept apart until the offsets are known
+    const size_t                       numberOfBlocks = (n + RowsPerBlock - 1) / RowsPerBlock;
+    std::vector<std::vector<uint32_t>> blockAdjacency(numberOfBlocks);
+    std::vector<size_t>                degrees(n);
+    const double                       ratioSquared = ratio * ratio;
+    threader->ParallelizeArray(
+      0,
+      numberOfBlocks,
+      [this, n, ratioSquared, &blockAdjacency, &degrees](SizeValueType block) {
+        std::vector<uint8_t> mask(n);
+        const size_t         rowEnd = std::min(n, (block + 1) * RowsPerBlock);
+        for (size_t i = block * RowsPerBlock; i < rowEnd; ++i)
+        {
+          this->ComputeRow(i, ratioSquared, mask.data());
+          mask[i] = 0;
+          size_t degree = 0;
+          for (size_t j = 0; j < n; ++j)
+          {
+            if (mask[j])
+            {
+              blockAdjacency[block].push_back(j);
+              degree++;
+            }
+          }
+          degrees[i] = degree;
+        }
+      },
+      nullptr);
+
+    this->offsets.resize(n + 1);
+    this->offsets[0] = 0;
+    for (size_t i = 0; i < n; ++i)
+      this->offsets[i + 1] = this->offsets[i] + degrees[i];
+    this->adjacency.resize(this->offsets[n]);
+    for (size_t block = 0; block < numberOfBlocks; ++block)
+    {
+      std::copy(blockAdjacency[block].begin(),
+                blockAdjacency[block].end(),
+                this->adjacency.begin() + this->offsets[block * RowsPerBlock]);
+    }
+    for (unsigned int k = 0; k < 6; ++k)
+    {
+      this->coordinates[k].clear();
+      this->coordinates[k].shrink_to_fit();
+    }
+  }
+
+  size_t
+  GetNumberOfVertices() const
+  {
+    return this->offsets.empty() ? 0 : this->offsets.size() - 1;
+  }
+
+  /** Number of edges, each counted once. */
+  size_t
+  GetNumberOfEdges() const
+  {
+    return this->adjacency.size() / 2;
+  }
+
+  size_t
+  GetDegree(size_t vertex) const
+  {
+    return this->offsets[vertex + 1] - this->offsets[vertex];
+  }
+
+  /** The neighbours of the vertex, GetDegree() of them in ascending order. */
+  const uint32_t *
+  GetNeighbors(size_t vertex) const
+  {
+    return this->adjacency.data() + this->offsets[vertex];
+  }
+
+  bool
+  IsEdge(size_t a, size_t b) const
+  {
+    return std::binary_search(this->GetNeighbors(a), this->GetNeighbors(a) + this->GetDegree(a), (uint32_t)b);
+  }
+
+  /**
+   * Find a large clique, in practice mostly a maximum one, in the manner of
+   * the heuristic of the parallel maximum clique solver of Rossi et al.:
+   * the vertices are visited by decreasing core number and each one is
+   * grown greedily into a clique within its neighbourhood, always adding the
+   * candidate of largest core number and keeping the candidates adjacent to
+   * all the clique. A vertex of core number c is in no clique larger than
+   * c + 1, so the search ends as soon as that cannot beat the best clique,
+   * and neighbours that cannot are never candidates.
+   * @return The vertices of the clique in ascending order.
+   */
+  std::vector<uint32_t>
+  FindLargeClique() const
+  {
+    const size_t          n = this->GetNumberOfVertices();
+    std::vector<uint32_t> core = this->ComputeCoreNumbers();
+
+    std::vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; ++i)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&core](uint32_t a, uint32_t b) {
+      return core[a] != core[b] ? core[a] > core[b] : a < b;
+    });
+
+    std::vector<uint32_t> best;
+    std::vector<uint32_t> clique;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> remaining;
+    for (uint32_t seed : order)
+    {
+      if (core[seed] + 1 <= best.size())
+        break;
+
+      clique.assign(1, seed);
+      candidates.clear();
+      const uint32_t * seedNeighbors = this->GetNeighbors(seed);
+      for (size_t k = 0; k < this->GetDegree(seed); ++k)
+      {
+        if (core[seedNeighbors[k]] + 1 > best.size())
+          candidates.push_back(seedNeighbors[k]);
+      }
+      while (!candidates.empty() && clique.size() + candidates.size() > best.size())
+      {
+        const uint32_t next = *std::max_element(
+          candidates.begin(), candidates.end(), [&core](uint32_t a, uint32_t b) { return core[a] < core[b]; });
+        clique.push_back(next);
+        // both are sorted, keep the candidates adjacent to next
+        remaining.clear();
+        std::set_intersection(candidates.begin(),
+                              candidates.end(),
+                              this->GetNeighbors(next),
+                              this->GetNeighbors(next) + this->GetDegree(next),
+                              std::back_inserter(remaining));
+        candidates.swap(remaining);
+      }
+      if (clique.size() > best.size())
+        best = clique;
+    }
+    std::sort(best.begin(), best.end());
+    return best;
+  }
+
+private:
+  /** Mark the vertices compatible with vertex i, without branches. */
+  void
+  ComputeRow(size_t i, double ratioSquared, uint8_t * mask) const
+  {
+    const double * fx = this->coordinates[0].data();
+    const double * fy = this->coordinates[1].data();
+    const double * fz = this->coordinates[2].data();
+    const double * mx = this->coordinates[3].data();
+    const double * my = this->coordinates[4].data();
+    const double * mz = this->coordinates[5].data();
+    const double   fxi = fx[i], fyi = fy[i], fzi = fz[i];
+    const double   mxi = mx[i], myi = my[i], mzi = mz[i];
+    const size_t   n = this->coordinates[0].size();
+    for (size_t j = 0; j < n; ++j)
+    {
+      const double dfx = fx[j] - fxi, dfy = fy[j] - fyi, dfz = fz[j] - fzi;
+      const double dmx = mx[j] - mxi, dmy = my[j] - myi, dmz = mz[j] - mzi;
+      const double fixedSquared = dfx * dfx + dfy * dfy + dfz * dfz;
+      const double movingSquared = dmx * dmx + dmy * dmy + dmz * dmz;
+      mask[j] = (fixedSquared >= ratioSquared * movingSquared) & (movingSquared >= ratioSquared * fixedSquared);
+    }
+  }
+
+  /** Core numbers by the bucket algorithm of Batagelj and Zaversnik, O(edges). */
+  std::vector<uint32_t>
+  ComputeCoreNumbers() const
+  {
+    const size_t          n = this->GetNumberOfVertices();
+    std::vector<uint32_t> degree(n);
+    size_t                maxDegree = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      degree[i] = this->GetDegree(i);
+      maxDegree = std::max<size_t>(maxDegree, degree[i]);
+    }
+
+    // vertices sorted by degree, bucketStart[d] is the first of degree d
+    std::vector<size_t>   bucketStart(maxDegree + 2, 0);
+    std::vector<uint32_t> sorted(n);
+    std::vector<size_t>   position(n);
+    for (size_t i = 0; i < n; ++i)
+      bucketStart[degree[i] + 1]++;
+    for (size_t d = 1; d < bucketStart.size(); ++d)
+      bucketStart[d] += bucketStart[d - 1];
+    for (size_t i = 0; i < n; ++i)
+    {
+      position[i] = bucketStart[degree[i]]++;
+      sorted[position[i]] = i;
+    }
+    for (size_t d = bucketStart.size() - 1; d > 0; --d)
+      bucketStart[d] = bucketStart[d - 1];
+    bucketStart[0] = 0;
+
+    // peel the vertex of least remaining degree, its neighbours of larger
+    // degree move down one bucket
+    for (size_t k = 0; k < n; ++k)
+    {
+      const uint32_t   v = sorted[k];
+      const uint32_t * neighbors = this->GetNeighbors(v);
+      for (size_t e = 0; e < this->GetDegree(v); ++e)
+      {
+        const uint32_t u = neighbors[e];
+        if (degree[u] > degree[v])
+        {
+          const size_t   first = bucketStart[degree[u]];
+          const uint32_t w = sorted[first];
+          if (u != w)
+          {
+            std::swap(sorted[position[u]], sorted[first]);
+            std::swap(position[u], position[w]);
+          }
+          bucketStart[degree[u]]++;
+          degree[u]--;
+        }
+      }
+    }
+    return degree;
+  }
+
+  // rows computed by one work unit
+  static constexpr size_t RowsPerBlock = 64;
+
+  std::vector<size_t>   offsets;
+  std::vector<uint32_t> adjacency;
+  // fixed x, y, z and moving x, y, z of every correspondence, only while
+  // building
+  std::vector<double> coordinates[6];
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkInlierScoringPolicy_h
+#define itkInlierScoringPolicy_h
+
+#include <math.h>
+
+namespace itk
+{
+
+/** \class InlierScoringPolicy
+ *
+ * \brief Score of a model, the sum over the data of per object terms.
+ *
+ * Every object closer to the model than the inlier threshold T contributes
+ * a term in (0,1], the others nothing, so the score of n objects is at most
+ * n and an evaluation can stop once even all the objects left cannot lift
+ * the score above the best one.
+ *
+ * RANSAC: every inlier counts 1, the score is the number of inliers.
+ *
+ * MSAC (Torr and Zisserman, "MLESAC: A New Robust Estimator with Application
+ * to Estimating Image Geometry", CVIU 2000): the truncated quadratic cost
+ * min(d^2, T^2), turned into the score 1 - d^2/T^2 per inlier. A model that
+ * fits its inliers closely ranks above one with as many loosely fitting
+ * inliers.
+ *
+ * MLESAC (same paper): the log likelihood ratio of a mixture of Gaussian
+ * inlier residuals, sigma^2 = T^2/7.81 (the 95% quantile of chi-square with
+ * three degrees of freedom), and outliers uniform over the ball of radius T,
+ * with equal priors, against the outlier distribution alone. It is
+ * normalized to 1 at d = 0.
+ *
+ * MAGSAC (Barath, Noskova, Ivashechkin and Matas, "MAGSAC++, a Fast,
+ * Reliable and Accurate Robust Estimator", CVPR 2020): no single noise
+ * scale, the quality is marginalized over sigma uniform in (0, sigma_max]
+ * with T = k sigma_max the largest threshold considered, k^2 = 11.34 the 99%
+ * quantile of chi-square with three degrees of freedom. For three degrees
+ * of freedom the marginal weight of a residual has the closed form
+ * w(d) = (exp(-u) - exp(-k^2/2)) / (1 - exp(-k^2/2)), u = d^2 / (2
+ * sigma_max^2), and the loss is its integral rho(d) = integral of t w(t)
+ * dt. The score of an inlier is 1 - rho(d) / rho(T). T only has to be an
+ * upper bound of the noise, the weights fall off well before it, so one
+ * large threshold replaces a search for the right one.
+ *
+ *  \ingroup Ransac
+ */
+class InlierScoringPolicy
+{
+public:
+  enum class Method
+  {
+    RANSAC,
+    MSAC,
+    MLESAC,
+    MAGSAC
+  };
+
+  InlierScoringPolicy() = default;
+
+  /**
+   * @param method The scoring method.
+   * @param thresholdSquared Square of the inlier threshold T.
+   */
+  InlierScoringPolicy(Method method, double thresholdSquared)
+    : method(method)
+    , inverseThresholdSquared(1.0 / thresholdSquared)
+  {
+    if (method == Method::MLESAC)
+    {
+      // ratio of the inlier density at d = 0 to the outlier density, the
+      // thresholds cancel: (4/3 pi T^3) / (2 pi T^2 / 7.81)^(3/2)
+      const double pi = 3.14159265358979323846;
+      const double densityRatio = (4.0 / 3.0 * pi) / pow(2.0 * pi / ChiSquare95, 1.5);
+      this->likelihoodRatio = densityRatio;
+      this->normalization = 1.0 / log(1.0 + densityRatio);
+    }
+    else if (method == Method::MAGSAC)
+    {
+      // rho(T) in units of sigma_max^2, without the factor 1 - exp(-k^2/2)
+      // the weights are normalized with
+      this->truncation = exp(-0.5 * ChiSquare99);
+      this->normalization = 1.0 / (1.0 - this->truncation - 0.5 * ChiSquare99 * this->truncation);
+    }
+  }
+
+  Method
+  GetMethod() const
+  {
+    return this->method;
+  }
+
+  /** Score of an inlier at the given squared distance, below T^2. */
+  inline double
+  operator()(double distanceSquared) const
+  {
+    switch (this->method)
+    {
+      case Method::MSAC:
+        return 1.0 - distanceSquared * this->inverseThresholdSquared;
+      case Method::MLESAC:
+        return this->normalization *
+               log(1.0 + this->likelihoodRatio * exp(-0.5 * ChiSquare95 * distanceSquared * this->inverseThresholdSquared));
+      case Method::MAGSAC:
+      {
+        const double u = 0.5 * ChiSquare99 * distanceSquared * this->inverseThresholdSquared;
+        return 1.0 - this->normalization * (1.0 - exp(-u) - this->truncation * u);
+      }
+      default:
+        return 1.0;
+    }
+  }
+
+  /**
+   * Weight of an inlier at the given squared distance, below T^2, in a
+   * weighted least squares fit to the inliers. The sigma-consensus weight
+   * for MAGSAC, 1 otherwise.
+   */
+  inline double
+  Weight(double distanceSquared) const
+  {
+    if (this->method != Method::MAGSAC)
+      return 1.0;
+    const double u = 0.5 * ChiSquare99 * distanceSquared * this->inverseThresholdSquared;
+    return (exp(-u) - this->truncation) / (1.0 - this->truncation);
+  }
+
+private:
+  static constexpr double ChiSquare95 = 7.81;
+  static constexpr double ChiSquare99 = 11.34;
+
+  Method method = Method::RANSAC;
+  double inverseThresholdSquared = 1.0;
+  double likelihoodRatio = 1.0;
+  double normalization = 1.0;
+  double truncation = 0.0;
+};
+
+} // end namespace itk
+
+#endif
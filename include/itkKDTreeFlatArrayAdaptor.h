@@ -0,0 +1,284 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkKDTreeFlatArrayAdaptor_h
+#define itkKDTreeFlatArrayAdaptor_h
+
+#include <memory>
+#include <new>
+#include <limits>
+#include <stdint.h>
+#include "nanoflann.hpp"
+#include "itkMacro.h"
+
+namespace itk
+{
+
+/** \class RadiusBoundedResultSet
+ *
+ * \brief nanoflann result set for "is there a point within the radius".
+ *
+ * Keeps the nearest point closer than the radius. Its worst distance starts
+ * at the squared radius, so the search skips the sibling subtrees farther
+ * away than that; it still descends to the leaf of the query point. With
+ * stopAtFirstHit the search ends at the first point within the radius, which
+ * is not necessarily the nearest one.
+ *
+ *  \ingroup Ransac
+ */
+template <typename DistanceType, typename IndexType>
+class RadiusBoundedResultSet
+{
+public:
+  RadiusBoundedResultSet(DistanceType inputRadiusSquared, bool inputStopAtFirstHit)
+    : radiusSquared(inputRadiusSquared)
+    , stopAtFirstHit(inputStopAtFirstHit)
+  {
+    this->init();
+  }
+
+  inline void
+  init()
+  {
+    this->distanceSquared = this->radiusSquared;
+    this->found = false;
+  }
+
+  /** @name Interface expected by nanoflann::KDTreeSingleIndexAdaptor
+   * @{ */
+  inline size_t
+  size() const
+  {
+    return this->found ? 1 : 0;
+  }
+
+  inline bool
+  full() const
+  {
+    return this->found;
+  }
+
+  /** Called for the points closer than worstDist() was when their leaf was
+   * entered, a nearer point of the same leaf may already have been kept.
+   * Returns false to end the search. */
+  inline bool
+  addPoint(DistanceType dist, IndexType index)
+  {
+    if (dist < this->distanceSquared)
+    {
+      this->distanceSquared = dist;
+      this->index = index;
+      this->found = true;
+    }
+    return !this->stopAtFirstHit;
+  }
+
+  inline DistanceType
+  worstDist() const
+  {
+    return this->distanceSquared;
+  }
+  /** @} */
+
+  bool
+  Found() const
+  {
+    return this->found;
+  }
+
+  DistanceType
+  GetDistanceSquared() const
+  {
+    return this->distanceSquared;
+  }
+
+  IndexType
+  GetIndex() const
+  {
+    return this->index;
+  }
+
+private:
+  DistanceType radiusSquared;
+  bool         stopAtFirstHit;
+  DistanceType distanceSquared;
+  IndexType    index = 0;
+  bool         found = false;
+};
+
+/** \class KDTreeFlatArrayAdaptor
+ *
+ * \brief nanoflann kd-tree over points stored in one contiguous array.
+ *
+ * The coordinates are copied into a single 64-byte aligned buffer, point i
+ * occupies [i*DIM, (i+1)*DIM). Compared with a vector of vectors this needs
+ * one allocation instead of one per point, and reading a coordinate while
+ * building or querying the tree is a single indexed load. The dimension is a
+ * compile time constant and the tree stores IndexType point ids, 32-bit by
+ * default, which halves the size of its index array.
+ *
+ * \tparam num_t Coordinate type.
+ * \tparam DIM Number of coordinates per point.
+ * \tparam IndexType Type of the point ids, it must be able to hold the
+ *         number of points.
+ *
+ *  \ingroup Ransac
+ */
+template <typename num_t = double, int DIM = 3, typename IndexType = uint32_t>
+class KDTreeFlatArrayAdaptor
+{
+public:
+  using Self = KDTreeFlatArrayAdaptor;
+  using metric_t = typename nanoflann::metric_L2_Simple::template traits<num_t, Self, IndexType>::distance_t;
+  using index_t = nanoflann::KDTreeSingleIndexAdaptor<metric_t, Self, DIM, IndexType>;
+
+  KDTreeFlatArrayAdaptor() = default;
+  KDTreeFlatArrayAdaptor(const KDTreeFlatArrayAdaptor &) = delete;
+  KDTreeFlatArrayAdaptor &
+  operator=(const KDTreeFlatArrayAdaptor &) = delete;
+
+  /**
+   * Copy the points and build the tree, replacing any previous points.
+   * @param points First coordinate of the first point, the DIM coordinates of
+   *               point i start at points[i * stride].
+   * @param stride Distance between consecutive points, in elements.
+   * @param numberOfPoints Number of points.
+   * @param leafMaxSize Maximum number of points in a leaf of the tree.
+   */
+  void
+  SetPoints(const num_t * points, size_t stride, size_t numberOfPoints, size_t leafMaxSize = 10)
+  {
+    if (numberOfPoints > static_cast<size_t>(std::numeric_limits<IndexType>::max()))
+    {
+      throw ExceptionObject(__FILE__, __LINE__, "Too many points for the index type of the kd-tree.");
+    }
+
+    this->index.reset();
+    this->coordinates.reset(static_cast<num_t *>(
+      ::operator new(sizeof(num_t) * DIM * (numberOfPoints > 0 ? numberOfPoints : 1), std::align_val_t(Alignment))));
+    this->size = numberOfPoints;
+    for (size_t i = 0; i < numberOfPoints; ++i)
+    {
+      for (int d = 0; d < DIM; ++d)
+      {
+        this->coordinates[i * DIM + d] = points[i * stride + d];
+      }
+    }
+
+    // the constructor builds the tree
+    this->index.reset(new index_t(DIM, *this, nanoflann::KDTreeSingleIndexAdaptorParams(leafMaxSize)));
+  }
+
+  /** The kd-tree, null until SetPoints() is called. */
+  const index_t *
+  GetIndex() const
+  {
+    return this->index.get();
+  }
+
+  /**
+   * Find a point closer than sqrt(radiusSquared) to the query point.
+   * @param query The DIM coordinates of the query point.
+   * @param radiusSquared Squared search radius, points at exactly this
+   *                      distance are not reported.
+   * @param stopAtFirstHit If false the nearest point within the radius is
+   *                       returned, if true any point within the radius.
+   * @param index Id of the point found.
+   * @param distanceSquared Squared distance to the point found.
+   * @return true if a point was found.
+   * A query at least the radius away from the bounding box of all the points
+   * returns false at once, without descending the tree.
+   */
+  bool
+  FindNeighborWithinRadius(const num_t * query,
+                           num_t         radiusSquared,
+                           bool          stopAtFirstHit,
+                           IndexType &   index,
+                           num_t &       distanceSquared) const
+  {
+    if (this->size == 0)
+      return false;
+
+    // squared distance to the bounding box of the root
+    num_t boxDistanceSquared = 0;
+    for (int d = 0; d < DIM; ++d)
+    {
+      const auto & interval = this->index->root_bbox[d];
+      const num_t  outside =
+        query[d] < interval.low ? interval.low - query[d] : (query[d] > interval.high ? query[d] - interval.high : 0);
+      boxDistanceSquared += outside * outside;
+    }
+    if (boxDistanceSquared >= radiusSquared)
+      return false;
+
+    RadiusBoundedResultSet<num_t, IndexType> resultSet(radiusSquared, stopAtFirstHit);
+    this->index->findNeighbors(resultSet, query, nanoflann::SearchParams());
+    index = resultSet.GetIndex();
+    distanceSquared = resultSet.GetDistanceSquared();
+    return resultSet.Found();
+  }
+
+  /** Coordinates of the idx'th point. */
+  const num_t *
+  GetPoint(size_t idx) const
+  {
+    return this->coordinates.get() + idx * DIM;
+  }
+
+  /** @name Interface expected by nanoflann::KDTreeSingleIndexAdaptor
+   * @{ */
+  inline size_t
+  kdtree_get_point_count() const
+  {
+    return this->size;
+  }
+
+  inline num_t
+  kdtree_get_pt(const size_t idx, const size_t dim) const
+  {
+    return this->coordinates[idx * DIM + dim];
+  }
+
+  template <class BBOX>
+  bool
+  kdtree_get_bbox(BBOX &) const
+  {
+    return false;
+  }
+  /** @} */
+
+private:
+  static constexpr size_t Alignment = 64;
+
+  struct AlignedDeleter
+  {
+    void
+    operator()(num_t * p) const
+    {
+      ::operator delete(p, std::align_val_t(Alignment));
+    }
+  };
+
+  std::unique_ptr<num_t[], AlignedDeleter> coordinates;
+  size_t                                   size = 0;
+  std::unique_ptr<index_t>                 index;
+};
+
+} // end namespace itk
+
+#endif
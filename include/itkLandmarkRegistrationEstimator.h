@@ -22,7 +22,8 @@
 #include "itkPoint.h"
 #include "itkObjectFactory.h"
 #include "itkPointsLocator.h"
-#include "KDTreeVectorOfVectorsAdaptor.h"
+#include "itkKDTreeFlatArrayAdaptor.h"
+#include "itkAffineTransformKernel.h"
 #include "itkParametersEstimator.h"
 namespace itk
 {
@@ -39,19 +40,16 @@ public:
   using Pointer = SmartPointer<Self>;
   using ConstPointer = SmartPointer<const Self>;
   
-  typedef std::vector<std::vector<double> > VectorofVectorsT;
-  using self_t =
-        KDTreeVectorOfVectorsAdaptor<VectorofVectorsT, double, 3, nanoflann::metric_L2>;
-  using metric_t =
-        typename nanoflann::metric_L2::template traits<double, self_t>::distance_t;
-  using index_t =
-        nanoflann::KDTreeSingleIndexAdaptor<metric_t, self_t, 3, size_t>;
-
-  using KdTreeT = KDTreeVectorOfVectorsAdaptor< VectorofVectorsT, double >;
+  /** kd-tree over the moving points of the agree data. */
+  using KdTreeT = KDTreeFlatArrayAdaptor<double, 3, uint32_t>;
 
   using PointsLocatorType = itk::PointsLocator<itk::VectorContainer<IdentifierType, itk::Point<double, 3>>>;
   using PointsContainer = itk::VectorContainer<IdentifierType, itk::Point<double, 3>>;
 
+  /** Affine map equivalent to a parameter vector of TTransform, it is what
+   * the inlier tests run against. */
+  using TransformKernel = AffineTransformKernel;
+
   itkTypeMacro(LandmarkRegistrationEstimator, ParametersEstimator);
   /** New method for creating an object using a factory. */
   itkNewMacro(Self);
@@ -66,18 +64,85 @@ public:
   virtual void
   LeastSquaresEstimate(std::vector<Point<double, Dimension>> & data, std::vector<double> & parameters) override;
 
+  using Superclass::WeightedLeastSquaresEstimate;
+  virtual void
+  WeightedLeastSquaresEstimate(std::vector<Point<double, Dimension> *> & data,
+                               const std::vector<double> &               weights,
+                               std::vector<double> &                     parameters) override;
+
+  /** Scoring policy of the scoring method with delta as the inlier threshold. */
+  virtual InlierScoringPolicy
+  GetScoringPolicy() override;
+
   virtual bool
   Agree(std::vector<double> & parameters, Point<double, Dimension> & data) override;
 
+  /** Agree() with the transform kernel set up once and the points
+   * transformed in blocks. */
+  virtual void
+  AgreeEach(std::vector<double> &                   parameters,
+            std::vector<Point<double, Dimension>> & data,
+            std::vector<char> &                     agree) override;
+
   virtual std::vector<double>
   AgreeMultiple(std::vector<double> & parameters, std::vector<Point<double, Dimension>> & data, unsigned int currentBest) override;
 
+  virtual std::vector<double>
+  AgreeMultipleSequential(std::vector<double> &                   parameters,
+                          std::vector<Point<double, Dimension>> & data,
+                          double                                  bestScore,
+                          const SequentialProbabilityRatioTest &  test,
+                          bool &                                  rejected,
+                          unsigned int &                          numberOfTested,
+                          double &                                score,
+                          std::vector<unsigned int> *             correspondences = nullptr) override;
+
+  virtual void
+  AgreeMultipleSequential(std::vector<double> &                   parameters,
+                          std::vector<Point<double, Dimension>> & data,
+                          double                                  bestScore,
+                          const SequentialProbabilityRatioTest &  test,
+                          bool &                                  rejected,
+                          unsigned int &                          numberOfTested,
+                          double &                                score,
+                          unsigned int &                          numberOfConsistent,
+                          double &                                residual,
+                          std::vector<double> &                   output,
+                          std::vector<unsigned int> *             correspondences = nullptr) override;
+
+  virtual double
+  AgreeBlock(std::vector<double> &                   parameters,
+             std::vector<Point<double, Dimension>> & data,
+             unsigned int                            begin,
+             unsigned int                            end,
+             double &                                residual) override;
+
+  /**
+   * Reject the subset if its fixed or its moving points are nearly colinear
+   * or coincide. With S the scatter matrix of the points of one side, of
+   * eigenvalues l1 >= l2 >= l3, the test is c2(S) >= threshold * tr(S)^2,
+   * where c2 is the sum of the principal 2x2 minors of S, l1 l2 + l1 l3 + l2
+   * l3. For three points, or any planar ones, the ratio c2 / tr^2 is l1 l2 /
+   * (l1 + l2)^2, about l2 / l1 for thin configurations and at most 1/4, so
+   * the threshold bounds the squared ratio of the widths of the points
+   * across and along their main direction. No eigen decomposition is
+   * needed, the cost is a few operations per point.
+   */
+  virtual bool
+  CheckSubSetConditioning(std::vector<Point<double, Dimension> *> & data, double threshold) override;
+
   virtual bool
   CheckCorresspondenceDistance(std::vector<double> & parameters, std::vector<Point<double, Dimension> *> & data) override;
 
   virtual bool
   CheckCorresspondenceEdgeLength(std::vector<double> & parameters, std::vector<Point<double, Dimension> *> & data, double edgeLength) override;
 
+  /**
+   * Set/Get the inlier threshold, a Euclidean distance and not a squared
+   * one: an object agrees with a model if its transformed fixed point is
+   * closer than delta to a moving point of the agree data, or to its own
+   * moving point for Agree and the inexpensive tests.
+   */
   virtual void
   SetDelta(double delta);
 
@@ -86,16 +151,129 @@ public:
 
   void SetAgreeData(std::vector<Point<double, Dimension>> & data);
 
+  /**
+   * If set, the kd-tree query of AgreeMultiple ends at the first point within
+   * delta instead of looking for the nearest one. The number of inliers is
+   * unchanged but the returned distances, and with them the RMSE used to
+   * break ties between hypotheses, are only upper bounds. Off by default.
+   */
+  virtual void
+  SetCountInliersOnly(bool flag);
+
+  virtual bool
+  GetCountInliersOnly();
+
+  /**
+   * Convert a parameter vector, as returned by Estimate, to the equivalent
+   * affine kernel. The wrapped transforms are converted directly from the
+   * versor, translation, scale and center, other transforms go through one
+   * TTransform instance.
+   */
+  static void
+  ComputeTransformKernel(const std::vector<double> & parameters, TransformKernel & kernel);
+
 protected:
   LandmarkRegistrationEstimator();
   ~LandmarkRegistrationEstimator() override = default;
 
 private:
+  /**
+   * Shared implementation of AgreeMultiple and AgreeMultipleSequential, the
+   * sequential test is skipped if test is null and the indexes of the
+   * matched fixed points are only stored if correspondences is not null.
+   * The evaluation stops once the score cannot reach bestScore. The result
+   * is written to output[0, numberOfTested), nothing is allocated once
+   * output and correspondences have the size of the data.
+   */
+  void
+  EvaluateInliers(std::vector<double> &                   parameters,
+                  std::vector<Point<double, Dimension>> & data,
+                  double                                  bestScore,
+                  const InlierScoringPolicy &             scoring,
+                  const SequentialProbabilityRatioTest *  test,
+                  bool &                                  rejected,
+                  unsigned int &                          numberOfTested,
+                  double &                                score,
+                  unsigned int &                          numberOfConsistent,
+                  double &                                residual,
+                  std::vector<double> &                   output,
+                  std::vector<unsigned int> *             correspondences);
+
+  /**
+   * Estimate the parameters with the landmark based transform initializer,
+   * used for transforms without a closed form solver.
+   */
+  void
+  InitializerEstimate(std::vector<Point<double, Dimension> *> & data, std::vector<double> & parameters);
+
+  /**
+   * Closed form least squares estimate for the wrapped transforms. The
+   * parameters are written in the layout of the transform, [versor,
+   * translation, (scale), center], where the center is the centroid of the
+   * fixed points. Runs on the stack without any heap allocation once the
+   * parameters vector has its final size. Degenerate data gives empty
+   * parameters.
+   * @param weights Weight of every point, null for equal weights.
+   * @return false if the transform type has no closed form solver.
+   */
+  static bool
+  ClosedFormEstimate(Point<double, Dimension> * const * data,
+                     unsigned int                       numberOfPoints,
+                     const double *                     weights,
+                     std::vector<double> &              parameters,
+                     const Similarity3DTransform<double> *);
+  static bool
+  ClosedFormEstimate(Point<double, Dimension> * const * data,
+                     unsigned int                       numberOfPoints,
+                     const double *                     weights,
+                     std::vector<double> &              parameters,
+                     const VersorRigid3DTransform<double> *);
+  template <typename TOtherTransform>
+  static bool
+  ClosedFormEstimate(Point<double, Dimension> * const *,
+                     unsigned int,
+                     const double *,
+                     std::vector<double> &,
+                     const TOtherTransform *)
+  {
+    return false;
+  }
+
+  static void
+  ComputeTransformKernel(const std::vector<double> & parameters, TransformKernel & kernel, const Similarity3DTransform<double> *);
+  static void
+  ComputeTransformKernel(const std::vector<double> & parameters, TransformKernel & kernel, const VersorRigid3DTransform<double> *);
+  template <typename TOtherTransform>
+  static void
+  ComputeTransformKernel(const std::vector<double> & parameters, TransformKernel & kernel, const TOtherTransform *);
+
+  /**
+   * Kernel of the transform x -> scale * R(versor) * (x - center) + center + translation.
+   */
+  static void
+  ComputeVersorTransformKernel(const double * versor, const double * translation, double scale, const double * center, TransformKernel & kernel);
+
+  /**
+   * Horn's quaternion method with Umeyama's scale, maps the fixed points
+   * data[i][0..2] onto the moving points data[i][3..5]. The 4x4 symmetric
+   * eigenproblem is solved with cyclic Jacobi rotations.
+   * @param weights Weight of every point, null for equal weights.
+   * @param versor Output rotation as a unit quaternion (x, y, z, w), w >= 0.
+   * @param scale Output least squares scale.
+   * @return false if the fixed points coincide or the weights are all 0.
+   */
+  static bool
+  ComputeClosedFormSimilarity(Point<double, Dimension> * const * data,
+                              unsigned int                       numberOfPoints,
+                              const double *                     weights,
+                              double                             versor[4],
+                              double &                           scale,
+                              double                             fixedCentroid[3],
+                              double                             movingCentroid[3]);
+
   double delta;
-  PointsLocatorType::Pointer pointsLocator;
-  PointsContainer::Pointer agreePoints;
-  VectorofVectorsT samples;
-  KdTreeT * mat_adaptor;
+  bool    countInliersOnly;
+  KdTreeT mat_adaptor;
 };
 
 } // end namespace itk
@@ -34,6 +34,7 @@ template <unsigned int Dimension, typename TTransform>
 LandmarkRegistrationEstimator<Dimension, TTransform>::LandmarkRegistrationEstimator()
 {
   this->delta = NumericTraits<double>::min();
+  this->countInliersOnly = false;
   this->minForEstimate = Dimension;
 }
 
@@ -51,11 +52,95 @@ LandmarkRegistrationEstimator<Dimension, TTransform>::GetDelta()
   return this->delta;
 }
 
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::SetCountInliersOnly(bool flag)
+{
+  this->countInliersOnly = flag;
+}
+
+template <unsigned int Dimension, typename TTransform>
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::GetCountInliersOnly()
+{
+  return this->countInliersOnly;
+}
+
 
 template <unsigned int Dimension, typename TTransform>
 void
 LandmarkRegistrationEstimator<Dimension, TTransform>::Estimate(std::vector<Point<double, Dimension> *> & data,
                                                    std::vector<double> &                     parameters)
+{
+  if (ClosedFormEstimate(data.data(), data.size(), nullptr, parameters, static_cast<const TTransform *>(nullptr)))
+    return;
+  InitializerEstimate(data, parameters);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::Estimate(std::vector<Point<double, Dimension>> & data,
+                                                   std::vector<double> &                   parameters)
+{
+  std::vector<Point<double, Dimension> *> usedData;
+  int                                     dataSize = data.size();
+  for (int i = 0; i < dataSize; i++)
+  {
+    usedData.push_back(&(data[i]));
+  }
+  Estimate(usedData, parameters);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::LeastSquaresEstimate(std::vector<Point<double, Dimension> *> & data,
+                                                               std::vector<double> &                     parameters)
+{
+  if (ClosedFormEstimate(data.data(), data.size(), nullptr, parameters, static_cast<const TTransform *>(nullptr)))
+    return;
+  InitializerEstimate(data, parameters);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::LeastSquaresEstimate(std::vector<Point<double, Dimension>> & data,
+                                                               std::vector<double> &                   parameters)
+{
+  std::vector<Point<double, Dimension> *> usedData;
+  int                                     dataSize = data.size();
+  usedData.reserve(dataSize);
+  for (int i = 0; i < dataSize; i++)
+  {
+    usedData.push_back(&(data[i]));
+  }
+  LeastSquaresEstimate(usedData, parameters);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::WeightedLeastSquaresEstimate(
+  std::vector<Point<double, Dimension> *> & data,
+  const std::vector<double> &               weights,
+  std::vector<double> &                     parameters)
+{
+  if (ClosedFormEstimate(
+        data.data(), data.size(), weights.data(), parameters, static_cast<const TTransform *>(nullptr)))
+    return;
+  // the initializer has no weights, fit the points that have one
+  Superclass::WeightedLeastSquaresEstimate(data, weights, parameters);
+}
+
+template <unsigned int Dimension, typename TTransform>
+InlierScoringPolicy
+LandmarkRegistrationEstimator<Dimension, TTransform>::GetScoringPolicy()
+{
+  return InlierScoringPolicy(this->scoringMethod, this->delta * this->delta);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::InitializerEstimate(std::vector<Point<double, Dimension> *> & data,
+                                                              std::vector<double> &                     parameters)
 {
   parameters.clear();
 
@@ -113,95 +198,239 @@ LandmarkRegistrationEstimator<Dimension, TTransform>::Estimate(std::vector<Point
 }
 
 template <unsigned int Dimension, typename TTransform>
-void
-LandmarkRegistrationEstimator<Dimension, TTransform>::Estimate(std::vector<Point<double, Dimension>> & data,
-                                                   std::vector<double> &                   parameters)
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeClosedFormSimilarity(Point<double, Dimension> * const * data,
+                                                                              unsigned int numberOfPoints,
+                                                                              const double * weights,
+                                                                              double       versor[4],
+                                                                              double &     scale,
+                                                                              double       fixedCentroid[3],
+                                                                              double       movingCentroid[3])
 {
-  std::vector<Point<double, Dimension> *> usedData;
-  int                                     dataSize = data.size();
-  for (int i = 0; i < dataSize; i++)
+  if (numberOfPoints == 0)
+    return false;
+
+  for (unsigned int k = 0; k < 3; ++k)
   {
-    usedData.push_back(&(data[i]));
+    fixedCentroid[k] = 0.0;
+    movingCentroid[k] = 0.0;
+  }
+  double totalWeight = 0.0;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+  {
+    const Point<double, Dimension> & pnt = *(data[i]);
+    const double                     weight = weights ? weights[i] : 1.0;
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      fixedCentroid[k] += weight * pnt[k];
+      movingCentroid[k] += weight * pnt[k + 3];
+    }
+    totalWeight += weight;
+  }
+  if (!(totalWeight > 0.0))
+    return false;
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    fixedCentroid[k] /= totalWeight;
+    movingCentroid[k] /= totalWeight;
   }
-  Estimate(usedData, parameters);
-}
-
-template <unsigned int Dimension, typename TTransform>
-void
-LandmarkRegistrationEstimator<Dimension, TTransform>::LeastSquaresEstimate(std::vector<Point<double, Dimension> *> & data,
-                                                               std::vector<double> &                     parameters)
-{
-  parameters.clear();
 
-  using PixelType = float;
-  constexpr unsigned int DimensionPoint = 3;
-  using FixedImageType = itk::Image<PixelType, DimensionPoint>;
-  using MovingImageType = itk::Image<PixelType, DimensionPoint>;
+  // cross covariance S(a,b) = sum weight * fixed(a) * moving(b) of the
+  // centered points
+  double S[3][3] = { { 0.0 } };
+  double fixedVariance = 0.0;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+  {
+    const Point<double, Dimension> & pnt = *(data[i]);
+    const double                     weight = weights ? weights[i] : 1.0;
+    double fixedCentered[3], movingCentered[3];
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      fixedCentered[k] = pnt[k] - fixedCentroid[k];
+      movingCentered[k] = weight * (pnt[k + 3] - movingCentroid[k]);
+      fixedVariance += weight * fixedCentered[k] * fixedCentered[k];
+    }
+    for (unsigned int a = 0; a < 3; ++a)
+      for (unsigned int b = 0; b < 3; ++b)
+        S[a][b] += fixedCentered[a] * movingCentered[b];
+  }
+  // a spread below the rounding error of the centroid is no spread at all
+  double centroidNorm = 0.0;
+  for (unsigned int k = 0; k < 3; ++k)
+    centroidNorm += fixedCentroid[k] * fixedCentroid[k];
+  if (!(fixedVariance > 1e-20 * totalWeight * centroidNorm))
+    return false;
+
+  // Horn's symmetric matrix, its largest eigenvector is the rotation
+  // quaternion (w, x, y, z) maximizing sum moving . R fixed
+  double N[4][4] = {
+    { S[0][0] + S[1][1] + S[2][2], S[1][2] - S[2][1], S[2][0] - S[0][2], S[0][1] - S[1][0] },
+    { S[1][2] - S[2][1], S[0][0] - S[1][1] - S[2][2], S[0][1] + S[1][0], S[2][0] + S[0][2] },
+    { S[2][0] - S[0][2], S[0][1] + S[1][0], -S[0][0] + S[1][1] - S[2][2], S[1][2] + S[2][1] },
+    { S[0][1] - S[1][0], S[2][0] + S[0][2], S[1][2] + S[2][1], -S[0][0] - S[1][1] + S[2][2] }
+  };
+  double V[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+
+  // cyclic Jacobi, converges quadratically, a handful of sweeps suffice
+  for (unsigned int sweep = 0; sweep < 32; ++sweep)
+  {
+    double offDiagonal = 0.0;
+    double diagonal = 0.0;
+    for (unsigned int p = 0; p < 4; ++p)
+    {
+      diagonal += N[p][p] * N[p][p];
+      for (unsigned int q = p + 1; q < 4; ++q)
+        offDiagonal += N[p][q] * N[p][q];
+    }
+    if (offDiagonal <= 1e-30 * diagonal)
+      break;
 
-  using TransformInitializerType =
-    itk::LandmarkBasedTransformInitializer<TTransform, FixedImageType, MovingImageType>;
-  
-  auto initializer = TransformInitializerType::New();
-  auto transform = TTransform::New();
-  
-  itk::Point<double, 3>                                     point;
-  typename TransformInitializerType::LandmarkPointContainer fixedLandmarks;
-  typename TransformInitializerType::LandmarkPointContainer movingLandmarks;
+    for (unsigned int p = 0; p < 3; ++p)
+    {
+      for (unsigned int q = p + 1; q < 4; ++q)
+      {
+        const double apq = N[p][q];
+        if (apq == 0.0)
+          continue;
+        const double theta = (N[q][q] - N[p][p]) / (2.0 * apq);
+        double       t = 1.0 / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+        if (theta < 0.0)
+          t = -t;
+        const double c = 1.0 / std::sqrt(t * t + 1.0);
+        const double sn = t * c;
+
+        N[p][p] -= t * apq;
+        N[q][q] += t * apq;
+        N[p][q] = N[q][p] = 0.0;
+        for (unsigned int r = 0; r < 4; ++r)
+        {
+          if (r != p && r != q)
+          {
+            const double arp = N[r][p];
+            const double arq = N[r][q];
+            N[r][p] = N[p][r] = c * arp - sn * arq;
+            N[r][q] = N[q][r] = sn * arp + c * arq;
+          }
+          const double vrp = V[r][p];
+          const double vrq = V[r][q];
+          V[r][p] = c * vrp - sn * vrq;
+          V[r][q] = sn * vrp + c * vrq;
+        }
+      }
+    }
+  }
 
-  // Create landmark points from the 6D input points
-  for (unsigned int i = 0; i < data.size(); ++i)
+  unsigned int largest = 0;
+  for (unsigned int p = 1; p < 4; ++p)
   {
-    Point<double, Dimension> & pnt = *(data[i]);
+    if (N[p][p] > N[largest][largest])
+      largest = p;
+  }
 
-    point[0] = pnt[0];
-    point[1] = pnt[1];
-    point[2] = pnt[2];
-    fixedLandmarks.push_back(point);
+  double       norm = 0.0;
+  const double sign = V[0][largest] < 0.0 ? -1.0 : 1.0;
+  for (unsigned int p = 0; p < 4; ++p)
+    norm += V[p][largest] * V[p][largest];
+  norm = sign / std::sqrt(norm);
+  versor[0] = V[1][largest] * norm;
+  versor[1] = V[2][largest] * norm;
+  versor[2] = V[3][largest] * norm;
+  versor[3] = V[0][largest] * norm;
+
+  // the largest eigenvalue is sum moving . R fixed
+  scale = N[largest][largest] / fixedVariance;
+  return true;
+}
 
-    point[0] = pnt[3];
-    point[1] = pnt[4];
-    point[2] = pnt[5];
-    movingLandmarks.push_back(point);
+template <unsigned int Dimension, typename TTransform>
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::ClosedFormEstimate(Point<double, Dimension> * const * data,
+                                                                     unsigned int numberOfPoints,
+                                                                     const double * weights,
+                                                                     std::vector<double> & parameters,
+                                                                     const Similarity3DTransform<double> *)
+{
+  double versor[4], scale, fixedCentroid[3], movingCentroid[3];
+  if (!ComputeClosedFormSimilarity(data, numberOfPoints, weights, versor, scale, fixedCentroid, movingCentroid) ||
+      !(scale > 0.0))
+  {
+    parameters.clear();
+    return true;
   }
 
-  initializer->SetMovingLandmarks(movingLandmarks);
-  initializer->SetFixedLandmarks(fixedLandmarks);
-  initializer->SetTransform(transform);
-  initializer->InitializeTransform();
+  // [versor, translation, scale] followed by the center, with the center
+  // at the fixed centroid the translation maps it onto the moving centroid
+  parameters.resize(10);
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    parameters[k] = versor[k];
+    parameters[k + 3] = movingCentroid[k] - fixedCentroid[k];
+    parameters[k + 7] = fixedCentroid[k];
+  }
+  parameters[6] = scale;
+  return true;
+}
 
-  // Copy the transform parameters in the input variable
-  auto transformParameters = transform->GetParameters();
-  for (unsigned int i = 0; i < transformParameters.GetSize(); ++i)
+template <unsigned int Dimension, typename TTransform>
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::ClosedFormEstimate(Point<double, Dimension> * const * data,
+                                                                     unsigned int numberOfPoints,
+                                                                     const double * weights,
+                                                                     std::vector<double> & parameters,
+                                                                     const VersorRigid3DTransform<double> *)
+{
+  double versor[4], scale, fixedCentroid[3], movingCentroid[3];
+  if (!ComputeClosedFormSimilarity(data, numberOfPoints, weights, versor, scale, fixedCentroid, movingCentroid))
   {
-    parameters.push_back(transformParameters.GetElement(i));
+    parameters.clear();
+    return true;
   }
 
-  auto fixedParameters = transform->GetFixedParameters();
-  for (unsigned int i = 0; i < fixedParameters.GetSize(); ++i)
+  // [versor, translation] followed by the center
+  parameters.resize(9);
+  for (unsigned int k = 0; k < 3; ++k)
   {
-    parameters.push_back(fixedParameters.GetElement(i));
+    parameters[k] = versor[k];
+    parameters[k + 3] = movingCentroid[k] - fixedCentroid[k];
+    parameters[k + 6] = fixedCentroid[k];
   }
-  return;
+  return true;
 }
 
 template <unsigned int Dimension, typename TTransform>
 void
-LandmarkRegistrationEstimator<Dimension, TTransform>::LeastSquaresEstimate(std::vector<Point<double, Dimension>> & data,
-                                                               std::vector<double> &                   parameters)
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeTransformKernel(const std::vector<double> & parameters,
+                                                                         TransformKernel &           kernel)
 {
-  std::vector<Point<double, Dimension> *> usedData;
-  int                                     dataSize = data.size();
-  usedData.reserve(dataSize);
-  for (int i = 0; i < dataSize; i++)
-  {
-    usedData.push_back(&(data[i]));
-  }
-  LeastSquaresEstimate(usedData, parameters);
+  ComputeTransformKernel(parameters, kernel, static_cast<const TTransform *>(nullptr));
 }
 
 template <unsigned int Dimension, typename TTransform>
-bool
-LandmarkRegistrationEstimator<Dimension, TTransform>::Agree(std::vector<double> & parameters, Point<double, Dimension> & data)
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeTransformKernel(const std::vector<double> & parameters,
+                                                                         TransformKernel &           kernel,
+                                                                         const Similarity3DTransform<double> *)
+{
+  // [versor, translation, scale, center]
+  ComputeVersorTransformKernel(&parameters[0], &parameters[3], parameters[6], &parameters[7], kernel);
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeTransformKernel(const std::vector<double> & parameters,
+                                                                         TransformKernel &           kernel,
+                                                                         const VersorRigid3DTransform<double> *)
+{
+  // [versor, translation, center]
+  ComputeVersorTransformKernel(&parameters[0], &parameters[3], 1.0, &parameters[6], kernel);
+}
+
+template <unsigned int Dimension, typename TTransform>
+template <typename TOtherTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeTransformKernel(const std::vector<double> & parameters,
+                                                                         TransformKernel &           kernel,
+                                                                         const TOtherTransform *)
 {
   auto transform = TTransform::New();
 
@@ -225,52 +454,115 @@ LandmarkRegistrationEstimator<Dimension, TTransform>::Agree(std::vector<double>
   }
   transform->SetParameters(optParameters);
 
-  itk::Point<double, 3> p0;
-  itk::Point<double, 3> p1;
+  const auto & matrix = transform->GetMatrix();
+  const auto & offset = transform->GetOffset();
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    for (unsigned int c = 0; c < 3; ++c)
+    {
+      kernel.matrix[r][c] = matrix[r][c];
+    }
+    kernel.offset[r] = offset[r];
+  }
+}
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::ComputeVersorTransformKernel(const double * versor,
+                                                                               const double * translation,
+                                                                               double         scale,
+                                                                               const double * center,
+                                                                               TransformKernel & kernel)
+{
+  // the versor parameters are its right part, w is implied (see itk::Versor)
+  const double x = versor[0];
+  const double y = versor[1];
+  const double z = versor[2];
+  const double w = std::sqrt(std::max(0.0, 1.0 - x * x - y * y - z * z));
+
+  kernel.matrix[0][0] = scale * (1.0 - 2.0 * (y * y + z * z));
+  kernel.matrix[1][1] = scale * (1.0 - 2.0 * (x * x + z * z));
+  kernel.matrix[2][2] = scale * (1.0 - 2.0 * (x * x + y * y));
+  kernel.matrix[0][1] = scale * (2.0 * (x * y - z * w));
+  kernel.matrix[0][2] = scale * (2.0 * (x * z + y * w));
+  kernel.matrix[1][0] = scale * (2.0 * (x * y + z * w));
+  kernel.matrix[2][0] = scale * (2.0 * (x * z - y * w));
+  kernel.matrix[2][1] = scale * (2.0 * (y * z + x * w));
+  kernel.matrix[1][2] = scale * (2.0 * (y * z - x * w));
+
+  // offset = center + translation - matrix * center
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    kernel.offset[r] = center[r] + translation[r] - kernel.matrix[r][0] * center[0] - kernel.matrix[r][1] * center[1] -
+                       kernel.matrix[r][2] * center[2];
+  }
+}
 
-  p0[0] = data[0];
-  p0[1] = data[1];
-  p0[2] = data[2];
+template <unsigned int Dimension, typename TTransform>
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::Agree(std::vector<double> & parameters, Point<double, Dimension> & data)
+{
+  TransformKernel kernel;
+  ComputeTransformKernel(parameters, kernel);
 
-  p1[0] = data[3];
-  p1[1] = data[4];
-  p1[2] = data[5];
+  double transformedPoint[3];
+  kernel.TransformPoint(data.GetDataPointer(), transformedPoint);
 
-  auto transformedPoint = transform->TransformPoint(p0);
-  auto distance = transformedPoint.EuclideanDistanceTo(p1);
-  return (distance < this->delta);
+  double distance = 0.0;
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    distance += (transformedPoint[k] - data[k + 3]) * (transformedPoint[k] - data[k + 3]);
+  }
+  return (std::sqrt(distance) < this->delta);
 }
 
 
 template <unsigned int Dimension, typename TTransform>
 void
-LandmarkRegistrationEstimator<Dimension, TTransform>::SetAgreeData(std::vector<Point<double, Dimension>> & data)
+LandmarkRegistrationEstimator<Dimension, TTransform>::AgreeEach(std::vector<double> &                   parameters,
+                                                                std::vector<Point<double, Dimension>> & data,
+                                                                std::vector<char> &                     agree)
 {
-  this->agreePoints = PointsContainer::New();
-  this->agreePoints->reserve(data.size());
-  
-  this->samples.resize(data.size());
-
-  unsigned int dim = 3;
-  itk::Point<double, 3> testPoint;
-
-  for (unsigned int i = 0; i < data.size(); ++i)
+  TransformKernel kernel;
+  ComputeTransformKernel(parameters, kernel);
+
+  // the distance to the own moving point, compared squared
+  const double           deltaSquared = this->delta * this->delta;
+  constexpr unsigned int blockSize = 64;
+  alignas(64) double     transformedX[blockSize];
+  alignas(64) double     transformedY[blockSize];
+  alignas(64) double     transformedZ[blockSize];
+
+  const unsigned int dataSize = data.size();
+  agree.resize(dataSize);
+  for (unsigned int blockStart = 0; blockStart < dataSize; blockStart += blockSize)
   {
-    auto point = data[i];
-    testPoint[0] = point[3];
-    testPoint[1] = point[4];
-    testPoint[2] = point[5];
-    this->agreePoints->InsertElement(i, testPoint);
-
-    this->samples[i].resize(dim);
-    for (size_t d = 0; d < dim; d++)
+    unsigned int blockEnd = std::min(blockStart + blockSize, dataSize);
+    kernel.TransformPoints(
+      data[blockStart].GetDataPointer(), Dimension, blockEnd - blockStart, transformedX, transformedY, transformedZ);
+    for (unsigned int i = blockStart; i < blockEnd; ++i)
     {
-      this->samples[i][d] = testPoint[d];
+      const double dx = transformedX[i - blockStart] - data[i][3];
+      const double dy = transformedY[i - blockStart] - data[i][4];
+      const double dz = transformedZ[i - blockStart] - data[i][5];
+      agree[i] = dx * dx + dy * dy + dz * dz < deltaSquared;
     }
   }
+}
+
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::SetAgreeData(std::vector<Point<double, Dimension>> & data)
+{
+  static_assert(Dimension >= 6, "the agree data are 6D correspondences");
+  if (data.empty())
+  {
+    throw ExceptionObject(__FILE__, __LINE__, "The agree data are empty.");
+  }
 
-  this->mat_adaptor = new KdTreeT(dim, this->samples, 5);
-  this->mat_adaptor->index->buildIndex();
+  // the moving points, i.e. coordinates 3..5 of every correspondence
+  this->mat_adaptor.SetPoints(data[0].GetDataPointer() + 3, Dimension, data.size(), 5);
 }
 
 template <unsigned int Dimension, typename TTransform>
@@ -319,50 +611,68 @@ LandmarkRegistrationEstimator<Dimension, TTransform>::CheckCorresspondenceEdgeLe
 
 template <unsigned int Dimension, typename TTransform>
 bool
-LandmarkRegistrationEstimator<Dimension, TTransform>::CheckCorresspondenceDistance(std::vector<double> & parameters,
-      std::vector<Point<double, Dimension> *> & data)
+LandmarkRegistrationEstimator<Dimension, TTransform>::CheckSubSetConditioning(
+  std::vector<Point<double, Dimension> *> & data,
+  double                                    threshold)
 {
-  auto transform = TTransform::New();
+  const unsigned int dataSize = data.size();
+  if (dataSize == 0)
+    return false;
 
-  auto optParameters = transform->GetParameters();
-  auto fixedParameters = transform->GetFixedParameters();
-
-  int counter = 0;
-  unsigned int totalParameters = optParameters.GetSize() + fixedParameters.GetSize();
-  for (unsigned int i = optParameters.GetSize(); i < totalParameters; ++i)
+  // fixed points data[i][0..2], then moving points data[i][3..5]
+  for (unsigned int side = 0; side < 6; side += 3)
   {
-    fixedParameters.SetElement(counter, parameters[i]);
-    counter = counter + 1;
-  }
-  transform->SetFixedParameters(fixedParameters);
+    double centroid[3] = { 0.0, 0.0, 0.0 };
+    for (unsigned int i = 0; i < dataSize; ++i)
+      for (unsigned int k = 0; k < 3; ++k)
+        centroid[k] += (*data[i])[side + k];
+    for (unsigned int k = 0; k < 3; ++k)
+      centroid[k] /= dataSize;
+
+    double S[3][3] = { { 0.0 } };
+    for (unsigned int i = 0; i < dataSize; ++i)
+    {
+      double centered[3];
+      for (unsigned int k = 0; k < 3; ++k)
+        centered[k] = (*data[i])[side + k] - centroid[k];
+      for (unsigned int a = 0; a < 3; ++a)
+        for (unsigned int b = a; b < 3; ++b)
+          S[a][b] += centered[a] * centered[b];
+    }
 
-  counter = 0;
-  for (unsigned int i = 0; i < optParameters.GetSize(); ++i)
-  {
-    optParameters.SetElement(counter, parameters[i]);
-    counter = counter + 1;
+    const double trace = S[0][0] + S[1][1] + S[2][2];
+    const double minors = S[0][0] * S[1][1] - S[0][1] * S[0][1] + S[0][0] * S[2][2] - S[0][2] * S[0][2] +
+                          S[1][1] * S[2][2] - S[1][2] * S[1][2];
+    // coincident points have no scatter at all
+    if (!(trace > 0.0) || minors <= threshold * trace * trace)
+      return false;
   }
-  transform->SetParameters(optParameters);
+  return true;
+}
+
+template <unsigned int Dimension, typename TTransform>
+bool
+LandmarkRegistrationEstimator<Dimension, TTransform>::CheckCorresspondenceDistance(std::vector<double> & parameters,
+      std::vector<Point<double, Dimension> *> & data)
+{
+  TransformKernel kernel;
+  ComputeTransformKernel(parameters, kernel);
 
-  itk::Point<double, 3> p0;
-  itk::Point<double, 3> p1;
+  double       transformedPoint[3];
+  const double deltaSquared = this->delta * this->delta;
 
   unsigned int dataSize =  data.size();
   for (unsigned int i=0; i < dataSize; ++i)
   {
     Point<double, Dimension> & pnt = *(data[i]);
+    kernel.TransformPoint(pnt.GetDataPointer(), transformedPoint);
 
-    p0[0] = pnt[0];
-    p0[1] = pnt[1];
-    p0[2] = pnt[2];
-
-    p1[0] = pnt[3];
-    p1[1] = pnt[4];
-    p1[2] = pnt[5];
-
-    auto transformedPoint = transform->TransformPoint(p0);
-    auto distance = p1.EuclideanDistanceTo(transformedPoint);
-    if (distance > this->delta)
+    double squaredDistance = 0.0;
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      squaredDistance += (transformedPoint[k] - pnt[k + 3]) * (transformedPoint[k] - pnt[k + 3]);
+    }
+    if (squaredDistance > deltaSquared)
     {
       return false;
     }
@@ -376,77 +686,246 @@ std::vector<double>
 LandmarkRegistrationEstimator<Dimension, TTransform>::AgreeMultiple(std::vector<double> & parameters, 
       std::vector<Point<double, Dimension>> & data, unsigned int currentBest)
 {
-  auto transform = TTransform::New();
+  // the bound is a number of votes, count the inliers
+  bool         rejected;
+  unsigned int numberOfTested, numberOfConsistent;
+  double       score, residual;
+  std::vector<double> output;
+  this->EvaluateInliers(parameters,
+                        data,
+                        currentBest,
+                        InlierScoringPolicy(),
+                        nullptr,
+                        rejected,
+                        numberOfTested,
+                        score,
+                        numberOfConsistent,
+                        residual,
+                        output,
+                        nullptr);
+  // the objects not checked are negative like the outliers
+  std::fill(output.begin() + numberOfTested, output.end(), -1.0);
+  return output;
+}
 
-  auto optParameters = transform->GetParameters();
-  auto fixedParameters = transform->GetFixedParameters();
 
-  int counter = 0;
-  unsigned int totalParameters = optParameters.GetSize() + fixedParameters.GetSize();
-  for (unsigned int i = optParameters.GetSize(); i < totalParameters; ++i)
-  {
-    fixedParameters.SetElement(counter, parameters[i]);
-    counter = counter + 1;
-  }
-  transform->SetFixedParameters(fixedParameters);
+template <unsigned int Dimension, typename TTransform>
+std::vector<double>
+LandmarkRegistrationEstimator<Dimension, TTransform>::AgreeMultipleSequential(
+  std::vector<double> &                   parameters,
+  std::vector<Point<double, Dimension>> & data,
+  double                                  bestScore,
+  const SequentialProbabilityRatioTest &  test,
+  bool &                                  rejected,
+  unsigned int &                          numberOfTested,
+  double &                                score,
+  std::vector<unsigned int> *             correspondences)
+{
+  unsigned int        numberOfConsistent;
+  double              residual;
+  std::vector<double> output;
+  this->AgreeMultipleSequential(parameters,
+                                data,
+                                bestScore,
+                                test,
+                                rejected,
+                                numberOfTested,
+                                score,
+                                numberOfConsistent,
+                                residual,
+                                output,
+                                correspondences);
+  // the objects not checked are negative like the outliers
+  std::fill(output.begin() + numberOfTested, output.end(), -1.0);
+  return output;
+}
 
-  counter = 0;
-  for (unsigned int i = 0; i < optParameters.GetSize(); ++i)
+
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::AgreeMultipleSequential(
+  std::vector<double> &                   parameters,
+  std::vector<Point<double, Dimension>> & data,
+  double                                  bestScore,
+  const SequentialProbabilityRatioTest &  test,
+  bool &                                  rejected,
+  unsigned int &                          numberOfTested,
+  double &                                score,
+  unsigned int &                          numberOfConsistent,
+  double &                                residual,
+  std::vector<double> &                   output,
+  std::vector<unsigned int> *             correspondences)
+{
+  const InlierScoringPolicy scoring = this->GetScoringPolicy();
+  this->EvaluateInliers(parameters,
+                        data,
+                        bestScore,
+                        scoring,
+                        &test,
+                        rejected,
+                        numberOfTested,
+                        score,
+                        numberOfConsistent,
+                        residual,
+                        output,
+                        correspondences);
+}
+
+
+template <unsigned int Dimension, typename TTransform>
+double
+LandmarkRegistrationEstimator<Dimension, TTransform>::AgreeBlock(std::vector<double> &                   parameters,
+                                                                 std::vector<Point<double, Dimension>> & data,
+                                                                 unsigned int                            begin,
+                                                                 unsigned int                            end,
+                                                                 double &                                residual)
+{
+  TransformKernel kernel;
+  ComputeTransformKernel(parameters, kernel);
+
+  uint32_t ret_index;
+  double   out_dist_sqr;
+  double   query_pt[3];
+
+  const double              deltaSquared = this->delta * this->delta;
+  const InlierScoringPolicy scoring = this->GetScoringPolicy();
+
+  // same blocked transform as EvaluateInliers, without per object output
+  constexpr unsigned int blockSize = 64;
+  alignas(64) double     transformedX[blockSize];
+  alignas(64) double     transformedY[blockSize];
+  alignas(64) double     transformedZ[blockSize];
+
+  double score = 0.0;
+  for (unsigned int blockStart = begin; blockStart < end; blockStart += blockSize)
   {
-    optParameters.SetElement(counter, parameters[i]);
-    counter = counter + 1;
-  }
-  transform->SetParameters(optParameters);
+    unsigned int blockEnd = std::min(blockStart + blockSize, end);
+    kernel.TransformPoints(
+      data[blockStart].GetDataPointer(), Dimension, blockEnd - blockStart, transformedX, transformedY, transformedZ);
 
-  std::vector<double> query_pt(3);
-  std::vector<double> output(data.size());
-  //output.reserve(data.size());
+    for (unsigned int i = 0; i < blockEnd - blockStart; ++i)
+    {
+      query_pt[0] = transformedX[i];
+      query_pt[1] = transformedY[i];
+      query_pt[2] = transformedZ[i];
+      if (this->mat_adaptor.FindNeighborWithinRadius(query_pt, deltaSquared, this->countInliersOnly, ret_index, out_dist_sqr))
+      {
+        score += scoring(out_dist_sqr);
+        residual += out_dist_sqr;
+      }
+    }
+  }
+  return score;
+}
 
-  const size_t num_results = 1;
-  std::vector<size_t> ret_indexes(num_results);
-  std::vector<double> out_dists_sqr(num_results);
-  nanoflann::KNNResultSet<double> resultSet(num_results);
 
-  itk::Point<double, 3> p0;
+template <unsigned int Dimension, typename TTransform>
+void
+LandmarkRegistrationEstimator<Dimension, TTransform>::EvaluateInliers(std::vector<double> &                   parameters,
+                                                                      std::vector<Point<double, Dimension>> & data,
+                                                                      double                                  bestScore,
+                                                                      const InlierScoringPolicy &             scoring,
+                                                                      const SequentialProbabilityRatioTest *  test,
+                                                                      bool &                                  rejected,
+                                                                      unsigned int &                          numberOfTested,
+                                                                      double &                                score,
+                                                                      unsigned int &                          numberOfConsistent,
+                                                                      double &                                residual,
+                                                                      std::vector<double> &                   output,
+                                                                      std::vector<unsigned int> *             correspondences)
+{
+  TransformKernel kernel;
+  ComputeTransformKernel(parameters, kernel);
+
+  static_assert(sizeof(Point<double, Dimension>) == Dimension * sizeof(double),
+                "the batched transform reads the points as one contiguous array");
+
+  // only the objects checked are written, -1 for an outlier, an inlier at
+  // distance 0 still counts, the rest of a buffer of a previous model is
+  // left alone
+  output.resize(data.size());
+  if (correspondences != nullptr)
+    correspondences->resize(data.size());
+
+  uint32_t ret_index;
+  double   out_dist_sqr;
+  double   query_pt[3];
+
+  // the search only looks for moving points within delta, it skips the
+  // subtrees farther away than that and the queries outside the bounding box
+  // of the points grown by delta
+  const double deltaSquared = this->delta * this->delta;
+
+  // the points are transformed in blocks with the batched (SIMD) kernel,
+  // the kd-tree queries then read the transformed coordinates
+  constexpr unsigned int blockSize = 64;
+  alignas(64) double     transformedX[blockSize];
+  alignas(64) double     transformedY[blockSize];
+  alignas(64) double     transformedZ[blockSize];
 
-  unsigned int localBest = 0;
   unsigned int dataSize =  data.size();
 
-  for (unsigned int i=0; i < dataSize; ++i)
+  // likelihood ratio of the sequential test, the model is rejected once it
+  // exceeds the decision threshold
+  double likelihoodRatio = 1.0;
+  rejected = false;
+  numberOfTested = 0;
+  score = 0.0;
+  numberOfConsistent = 0;
+  residual = 0.0;
+
+  for (unsigned int blockStart = 0; blockStart < dataSize && !rejected; blockStart += blockSize)
   {
-    // For early stopping. No point running if this condition is true
-    if (localBest + dataSize - i < currentBest)
+    // For early stopping. No point running if this condition is true, every
+    // object adds at most 1 to the score
+    if (score + (dataSize - blockStart) < bestScore)
     {
       break;
     }
-    p0[0] = data[i][0];
-    p0[1] = data[i][1];
-    p0[2] = data[i][2];
-
-    auto transformedPoint = transform->TransformPoint(p0);
-    
-    query_pt[0] = transformedPoint[0];
-    query_pt[1] = transformedPoint[1];
-    query_pt[2] = transformedPoint[2];
-    
-    resultSet.init(&ret_indexes[0], &out_dists_sqr[0] );
-    this->mat_adaptor->index->findNeighbors(resultSet, &query_pt[0], nanoflann::SearchParams(10));
-    bool flag = out_dists_sqr[0] < this->delta;
-    if (flag)
-    {
-      localBest++;
-      output[i] = out_dists_sqr[0];
-    }
-    else
+    unsigned int blockEnd = std::min(blockStart + blockSize, dataSize);
+    kernel.TransformPoints(
+      data[blockStart].GetDataPointer(), Dimension, blockEnd - blockStart, transformedX, transformedY, transformedZ);
+
+    for (unsigned int i = blockStart; i < blockEnd; ++i)
     {
-      output[i] = -1;
+      if (score + (dataSize - i) < bestScore)
+      {
+        break;
+      }
+      query_pt[0] = transformedX[i - blockStart];
+      query_pt[1] = transformedY[i - blockStart];
+      query_pt[2] = transformedZ[i - blockStart];
+
+      numberOfTested++;
+      bool flag = this->mat_adaptor.FindNeighborWithinRadius(
+        query_pt, deltaSquared, this->countInliersOnly, ret_index, out_dist_sqr);
+      if (flag)
+      {
+        score += scoring(out_dist_sqr);
+        numberOfConsistent++;
+        residual += out_dist_sqr;
+        output[i] = out_dist_sqr;
+        if (correspondences != nullptr)
+          (*correspondences)[i] = ret_index;
+      }
+      else
+      {
+        output[i] = -1;
+      }
+
+      if (test != nullptr)
+      {
+        likelihoodRatio *= flag ? test->GetConsistentFactor() : test->GetInconsistentFactor();
+        if (likelihoodRatio > test->GetDecisionThreshold())
+        {
+          rejected = true;
+          break;
+        }
+      }
     }
   }
-
-  return output;
 }
 
-
 } // end namespace itk
 
 #endif
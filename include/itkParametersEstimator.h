@@ -20,7 +20,10 @@
 #define itkParametersEstimator_h
 
 #include <vector>
+#include <limits>
 #include "itkObject.h"
+#include "itkSequentialProbabilityRatioTest.h"
+#include "itkInlierScoringPolicy.h"
 #include "itkSimilarity3DTransform.h"
 #include "itkVersorRigid3DTransform.h"
 
@@ -57,6 +60,8 @@ public:
 
   itkTypeMacro(ParametersEstimator, Object);
 
+  using ScoringMethod = InlierScoringPolicy::Method;
+
   /**
    * Exact estimation of parameters.
    * @param data The data used for the estimate.
@@ -79,6 +84,23 @@ public:
   virtual void
   LeastSquaresEstimate(std::vector<T> & data, std::vector<SType> & parameters) = 0;
 
+  /**
+   * Weighted least squares estimation of parameters, the sigma-consensus
+   * fit of the MAGSAC scoring method.
+   * @param data The data used for the estimate.
+   * @param weights Non negative weight of every data object.
+   * @param parameters This vector is cleared and then filled with the computed
+   *                   parameters.
+   * The default implementation calls LeastSquaresEstimate() with the objects
+   * of positive weight.
+   */
+  virtual void
+  WeightedLeastSquaresEstimate(std::vector<T *> &          data,
+                               const std::vector<double> & weights,
+                               std::vector<SType> &        parameters);
+  virtual void
+  WeightedLeastSquaresEstimate(std::vector<T> & data, const std::vector<double> & weights, std::vector<SType> & parameters);
+
   /**
    * This method tests if the given data agrees with the model defined by the
    * parameters.
@@ -86,9 +108,126 @@ public:
   virtual bool
   Agree(std::vector<SType> & parameters, T & data) = 0;
 
+  /**
+   * Agree() for every data object, agree is resized to data.size() and
+   * entry i set to 1 if data[i] agrees with the model, 0 otherwise. The
+   * default implementation calls Agree() for every object, estimators with a
+   * costly model setup should set it up once.
+   */
+  virtual void
+  AgreeEach(std::vector<SType> & parameters, std::vector<T> & data, std::vector<char> & agree);
+
+  /**
+   * Test every data object against the model. An entry is non negative for a
+   * consistent object (its residual, 0 included) and negative for the
+   * inconsistent objects and the ones not checked.
+   */
   virtual std::vector<double>
   AgreeMultiple(std::vector<SType> & parameters, std::vector<T> & data, unsigned int currentBest) = 0;
 
+  /**
+   * Inlier test with early rejection by the sequential probability ratio
+   * test. The data objects are checked in the given order, which should be
+   * random, and the test stops once the model is rejected. A test that is
+   * not active never rejects, the call is then a full inlier test.
+   * @param bestScore Score of the best model so far, the check also stops
+   *                  once the model cannot reach it any more.
+   * @param test The current parameters of the test.
+   * @param rejected Set to true if the test rejected the model.
+   * @param numberOfTested Set to the number of data objects checked.
+   * @param score Set to the score of the model on the objects checked, see
+   *              SetScoringMethod.
+   * @param correspondences If not null, resized to data.size() and entry i
+   *                        set to the index of the agree data object matched
+   *                        to data[i] (only meaningful for consistent
+   *                        objects), or to NoCorrespondence if the object is
+   *                        consistent by itself.
+   * @return As AgreeMultiple, entries of objects not checked are negative. The
+   *         default implementation calls Agree() for every object and
+   *         returns 1 for the consistent ones.
+   */
+  virtual std::vector<double>
+  AgreeMultipleSequential(std::vector<SType> &                 parameters,
+                          std::vector<T> &                     data,
+                          double                               bestScore,
+                          const SequentialProbabilityRatioTest & test,
+                          bool &                               rejected,
+                          unsigned int &                       numberOfTested,
+                          double &                             score,
+                          std::vector<unsigned int> *          correspondences = nullptr);
+
+  /**
+   * As above, with the result written to output, resized to data.size(),
+   * so that a caller scoring many models reuses one buffer. With the
+   * buffers of a thread grown once, an estimator can then evaluate a model
+   * without any heap allocation. Only the entries [0, numberOfTested) of
+   * output are written, the others keep the values of a previous model, so
+   * a model rejected early costs no more than the objects it was checked
+   * on. The default implementation moves the result of the other overload
+   * into output.
+   * @param numberOfConsistent Set to the number of consistent objects.
+   * @param residual Set to the sum of the entries of the consistent objects.
+   */
+  virtual void
+  AgreeMultipleSequential(std::vector<SType> &                 parameters,
+                          std::vector<T> &                     data,
+                          double                               bestScore,
+                          const SequentialProbabilityRatioTest & test,
+                          bool &                               rejected,
+                          unsigned int &                       numberOfTested,
+                          double &                             score,
+                          unsigned int &                       numberOfConsistent,
+                          double &                             residual,
+                          std::vector<double> &                output,
+                          std::vector<unsigned int> *          correspondences = nullptr);
+
+  /**
+   * Score the model on the data objects [begin, end) only, preemptive RANSAC
+   * scores its hypotheses block by block with this.
+   * @param residual Incremented by the sum of the values AgreeMultiple
+   *                 returns for the consistent objects of the block.
+   * @return The score of the model on the block. The default implementation
+   *         calls Agree() for every object and adds 1 to the score and to
+   *         residual per consistent one.
+   */
+  virtual double
+  AgreeBlock(std::vector<SType> & parameters, std::vector<T> & data, unsigned int begin, unsigned int end, double & residual);
+
+  /**
+   * Set/Get how AgreeMultipleSequential and AgreeBlock score a model, see
+   * InlierScoringPolicy. The default implementations only know whether an
+   * object agrees and always count inliers, estimators that measure the
+   * distance of an object to the model should score it with an
+   * InlierScoringPolicy of this method. RANSAC by default.
+   */
+  void
+  SetScoringMethod(ScoringMethod method);
+  ScoringMethod
+  GetScoringMethod();
+
+  /**
+   * Policy the scores and weights of the inliers are computed with. The
+   * default implementation has no distances and scores with an inlier
+   * threshold of 1, estimators with an inlier threshold use theirs.
+   */
+  virtual InlierScoringPolicy
+  GetScoringPolicy();
+
+  /** Correspondence of an object that agrees with the model by itself. */
+  static constexpr unsigned int NoCorrespondence = std::numeric_limits<unsigned int>::max();
+
+  /**
+   * Inexpensive test of a minimal subset, before its exact estimate, for
+   * configurations too close to degenerate to give a meaningful model (e.g.
+   * nearly colinear points for a rigid transform).
+   * @param threshold Conditioning bound in [0,1), larger rejects more, the
+   *                  meaning is up to the estimator.
+   * @return false if the subset is degenerate. The default implementation
+   *         accepts every subset.
+   */
+  virtual bool
+  CheckSubSetConditioning(std::vector<T *> & data, double threshold);
+
   virtual bool
   CheckCorresspondenceDistance(std::vector<SType> & parameters, std::vector<T *> & data) = 0;
 
@@ -107,11 +246,17 @@ public:
   GetMinimalForEstimate();
 
 protected:
-  ParametersEstimator() { this->minForEstimate = 0; }
+  ParametersEstimator()
+  {
+    this->minForEstimate = 0;
+    this->scoringMethod = ScoringMethod::RANSAC;
+  }
   ~ParametersEstimator() {}
 
   // minimal number of data objects required for an exact estimate
   unsigned int minForEstimate;
+  // how the inliers of a model are scored
+  ScoringMethod scoringMethod;
 
 private:
   ParametersEstimator(const Self &); // purposely not implemented
@@ -43,6 +43,178 @@ ParametersEstimator<T, SType>::GetMinimalForEstimate()
 }
 
 
+template <typename T, typename SType>
+void
+ParametersEstimator<T, SType>::SetScoringMethod(ScoringMethod method)
+{
+  this->scoringMethod = method;
+}
+
+
+template <typename T, typename SType>
+auto
+ParametersEstimator<T, SType>::GetScoringMethod() -> ScoringMethod
+{
+  return this->scoringMethod;
+}
+
+
+template <typename T, typename SType>
+InlierScoringPolicy
+ParametersEstimator<T, SType>::GetScoringPolicy()
+{
+  return InlierScoringPolicy(this->scoringMethod, 1.0);
+}
+
+
+template <typename T, typename SType>
+void
+ParametersEstimator<T, SType>::WeightedLeastSquaresEstimate(std::vector<T *> &          data,
+                                                            const std::vector<double> & weights,
+                                                            std::vector<SType> &        parameters)
+{
+  std::vector<T *> weightedData;
+  weightedData.reserve(data.size());
+  for (unsigned int i = 0; i < data.size(); ++i)
+  {
+    if (weights[i] > 0.0)
+      weightedData.push_back(data[i]);
+  }
+  this->LeastSquaresEstimate(weightedData, parameters);
+}
+
+
+template <typename T, typename SType>
+void
+ParametersEstimator<T, SType>::WeightedLeastSquaresEstimate(std::vector<T> &            data,
+                                                            const std::vector<double> & weights,
+                                                            std::vector<SType> &        parameters)
+{
+  std::vector<T *> usedData;
+  usedData.reserve(data.size());
+  for (unsigned int i = 0; i < data.size(); ++i)
+    usedData.push_back(&(data[i]));
+  this->WeightedLeastSquaresEstimate(usedData, weights, parameters);
+}
+
+
+template <typename T, typename SType>
+bool
+ParametersEstimator<T, SType>::CheckSubSetConditioning(std::vector<T *> &, double)
+{
+  return true;
+}
+
+
+template <typename T, typename SType>
+void
+ParametersEstimator<T, SType>::AgreeEach(std::vector<SType> & parameters,
+                                         std::vector<T> &     data,
+                                         std::vector<char> &  agree)
+{
+  agree.resize(data.size());
+  for (unsigned int i = 0; i < data.size(); ++i)
+    agree[i] = this->Agree(parameters, data[i]);
+}
+
+
+template <typename T, typename SType>
+std::vector<double>
+ParametersEstimator<T, SType>::AgreeMultipleSequential(std::vector<SType> &                 parameters,
+                                                       std::vector<T> &                     data,
+                                                       double                               bestScore,
+                                                       const SequentialProbabilityRatioTest & test,
+                                                       bool &                               rejected,
+                                                       unsigned int &                       numberOfTested,
+                                                       double &                             score,
+                                                       std::vector<unsigned int> *          correspondences)
+{
+  std::vector<double> output(data.size(), -1.0);
+  if (correspondences != nullptr)
+    correspondences->assign(data.size(), NoCorrespondence);
+  unsigned int        dataSize = data.size();
+  double              likelihoodRatio = 1.0;
+
+  rejected = false;
+  numberOfTested = 0;
+  score = 0.0;
+  for (unsigned int i = 0; i < dataSize; ++i)
+  {
+    // every object adds at most 1 to the score
+    if (score + (dataSize - i) < bestScore)
+      break;
+
+    numberOfTested++;
+    if (this->Agree(parameters, data[i]))
+    {
+      score += 1.0;
+      output[i] = 1.0;
+      likelihoodRatio *= test.GetConsistentFactor();
+    }
+    else
+    {
+      output[i] = -1.0;
+      likelihoodRatio *= test.GetInconsistentFactor();
+    }
+    if (likelihoodRatio > test.GetDecisionThreshold())
+    {
+      rejected = true;
+      break;
+    }
+  }
+  return output;
+}
+
+
+template <typename T, typename SType>
+void
+ParametersEstimator<T, SType>::AgreeMultipleSequential(std::vector<SType> &                 parameters,
+                                                       std::vector<T> &                     data,
+                                                       double                               bestScore,
+                                                       const SequentialProbabilityRatioTest & test,
+                                                       bool &                               rejected,
+                                                       unsigned int &                       numberOfTested,
+                                                       double &                             score,
+                                                       unsigned int &                       numberOfConsistent,
+                                                       double &                             residual,
+                                                       std::vector<double> &                output,
+                                                       std::vector<unsigned int> *          correspondences)
+{
+  // estimators that only implement the returning overload keep working
+  output = this->AgreeMultipleSequential(
+    parameters, data, bestScore, test, rejected, numberOfTested, score, correspondences);
+  numberOfConsistent = 0;
+  residual = 0.0;
+  for (unsigned int i = 0; i < numberOfTested; ++i)
+  {
+    if (output[i] >= 0.0)
+    {
+      numberOfConsistent++;
+      residual += output[i];
+    }
+  }
+}
+
+
+template <typename T, typename SType>
+double
+ParametersEstimator<T, SType>::AgreeBlock(std::vector<SType> & parameters,
+                                          std::vector<T> &     data,
+                                          unsigned int         begin,
+                                          unsigned int         end,
+                                          double &             residual)
+{
+  unsigned int numberOfConsistent = 0;
+  for (unsigned int i = begin; i < end; ++i)
+  {
+    if (this->Agree(parameters, data[i]))
+      numberOfConsistent++;
+  }
+  residual += numberOfConsistent;
+  return numberOfConsistent;
+}
+
+
 } // end namespace itk
 
 #endif //_PARAMETERS_ESTIMATOR_HXX_
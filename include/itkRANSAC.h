@@ -19,17 +19,31 @@
 #ifndef itkRANSAC_h
 #define itkRANSAC_h
 
-#include <set>
+#include <algorithm>
 #include <vector>
 #include <stdlib.h>
 #include <math.h>
-#include <time.h>
 #include <limits>
 #include "itkParametersEstimator.h"
+#include "itkSubSetFingerprintTable.h"
+#include "itkSubSetSampler.h"
+#include "itkSequentialProbabilityRatioTest.h"
+#include "itkKDTreeFlatArrayAdaptor.h"
+#include "itkCompatibilityGraph.h"
+#include "RandomNumberGenerator.h"
 #include "itkMultiThreaderBase.h"
+#include "itkPoolMultiThreader.h"
 #include <mutex>
+#include <atomic>
+#include <memory>
 #include "itkMacro.h"
 #include "nanoflann.hpp"
+#ifdef ITK_USE_TBB
+#  include "tbb/blocked_range.h"
+#  include "tbb/enumerable_thread_specific.h"
+#  include "tbb/parallel_for.h"
+#  include "tbb/task_arena.h"
+#endif
 
 /**
  * This class implements a multi-threaded version of the RAndom SAmple
@@ -87,6 +101,35 @@ public:
   using ParametersEstimatorType = typename itk::ParametersEstimator<T, SType>;
 
   itkTypeMacro(RANSAC, Object);
+
+  /** Strategies for drawing the minimal subsets. */
+  enum class SamplingStrategy
+  {
+    /** All subsets of the data are equally likely. */
+    Uniform,
+    /** PROSAC, subsets are drawn from a growing set of the best data
+     * objects, see SetDataQuality. */
+    PROSAC,
+    /** NAPSAC, a random seed object and its spatial neighbours, see
+     * SetNeighborhoodSize. */
+    NAPSAC,
+    /** Only subsets that pass the edge length test, see
+     * SetSamplingStrategy. */
+    Compatible
+  };
+
+  /** Use of the compatibility graph of the data, see
+   * SetCompatibilityPrefilter. */
+  enum class CompatibilityPrefilter
+  {
+    /** Hypotheses are drawn from all the data. */
+    None,
+    /** Hypotheses are drawn from the clique only. */
+    RANSAC,
+    /** The model is the least squares fit to the clique, no hypotheses are
+     * drawn. */
+    LeastSquares
+  };
   /** New method for creating an object using a factory. */
   itkNewMacro(Self);
 
@@ -101,6 +144,211 @@ public:
   unsigned int
   GetNumberOfThreads();
 
+  /**
+   * Set/Get the threader the hypotheses are computed with. It is kept across
+   * calls to Compute, each of which only sets its number of work units to the
+   * number of threads, so the threads of a pool are started once for all the
+   * registrations. By default a PoolMultiThreader is created by the first
+   * call, nullptr restores that. The global default number of threads of ITK
+   * is left unchanged.
+   */
+  void
+  SetMultiThreader(itk::MultiThreaderBase * threader);
+  itk::MultiThreaderBase *
+  GetMultiThreader();
+
+  /**
+   * Select how the maximal number of iterations is interpreted.
+   * @param globalBudget If false (default) every thread runs up to
+   *                     maxIteration iterations on its own. If true
+   *                     maxIteration is a budget shared by all threads, which
+   *                     claim iterations from it in chunks, so adding threads
+   *                     reduces the run time instead of increasing the work.
+   */
+  void
+  SetUseGlobalIterationBudget(bool globalBudget);
+  bool
+  GetUseGlobalIterationBudget();
+
+  /**
+   * Set/Get the number of iterations a thread claims at once from the global
+   * iteration budget. Only used when the global budget is enabled.
+   */
+  void
+  SetIterationChunkSize(unsigned int chunkSize);
+  unsigned int
+  GetIterationChunkSize();
+
+  /**
+   * Run the hypotheses as TBB tasks instead of one long running callback per
+   * thread, disabled by default and only available if ITK is built with TBB,
+   * otherwise the flag is ignored. The iterations are split in chunks of the
+   * iteration chunk size, a parallel_for in a task arena of the number of
+   * threads runs them and idle threads steal the chunks left, so threads
+   * drawing expensive hypotheses do not hold up the end of the run. The
+   * arena shares the TBB workers with the other TBB parallel filters of the
+   * process rather than starting threads of its own. The budget is shared
+   * by the threads, as with SetUseGlobalIterationBudget(true). For a fixed
+   * seed the result is the same only when the iteration budget is exhausted
+   * and SPRT is off, otherwise the point at which the adaptive termination
+   * or the sequential test stops depends on the scheduling of the chunks.
+   */
+  void
+  SetUseTaskBasedExecution(bool flag);
+  bool
+  GetUseTaskBasedExecution();
+
+  /**
+   * Enable the exhaustive enumeration of the minimal subsets, disabled by
+   * default. If all Choose(n, m) subsets fit in the iteration budget, every
+   * one of them is evaluated exactly once instead of drawing subsets at
+   * random: iteration i estimates the subset of rank i in the combinatorial
+   * number system, and the threads claim contiguous ranges of ranks from a
+   * shared counter, as with the global budget. No table of the subsets
+   * already drawn is needed and the adaptive termination is off, so the
+   * result is the best model over all subsets, the same for any number of
+   * threads. The sampling strategy is not used then, and preemptive scoring
+   * keeps drawing its hypotheses at random.
+   */
+  void
+  SetUseExhaustiveEnumeration(bool flag);
+  bool
+  GetUseExhaustiveEnumeration();
+
+  /**
+   * Set/Get the seed of the random number generators. Every hypothesis is
+   * drawn from its own counter based random stream derived from the seed and
+   * the hypothesis number, so for a fixed seed the drawn subsets do not depend
+   * on the scheduling of the threads. For a fixed seed and number of threads
+   * the result is reproducible, except for the exact point at which the
+   * adaptive termination stops the threads. Default seed is 0.
+   */
+  void
+  SetRandomSeed(uint64_t seed);
+  uint64_t
+  GetRandomSeed();
+
+  /**
+   * Get the total number of iterations (hypotheses drawn) performed by all
+   * threads during the last call to Compute.
+   */
+  size_t
+  GetNumberOfIterations();
+
+  /**
+   * Enable early rejection of bad hypotheses with Wald's sequential
+   * probability ratio test (SPRT), see SequentialProbabilityRatioTest. The
+   * agree data are then checked in a random order, fixed for each call to
+   * Compute (this needs a shuffled copy of the agree data), and the check of
+   * a hypothesis stops as soon as the test rejects it. The adaptive
+   * termination accounts for the good hypotheses the test may reject.
+   * Disabled by default.
+   */
+  void
+  SetUseSequentialProbabilityRatioTest(bool flag);
+  bool
+  GetUseSequentialProbabilityRatioTest();
+
+  /**
+   * Set the initial parameters of the sequential probability ratio test,
+   * both ratios are refined while the hypotheses are checked.
+   * @param inlierRatio Lower bound of the fraction of the agree data
+   *                    supporting the correct model, default 0.02.
+   * @param badModelInlierRatio Fraction of the agree data supporting a wrong
+   *                            model, must be smaller, default 0.002.
+   * @param timeRatio Time needed to estimate and pre-check a hypothesis in
+   *                  units of the time needed to check one agree object,
+   *                  default 50.
+   */
+  void
+  SetSequentialProbabilityRatioTestParameters(double inlierRatio, double badModelInlierRatio, double timeRatio);
+
+  /**
+   * Number of hypotheses rejected by the sequential probability ratio test,
+   * and the number of agree objects checked against all hypotheses, during
+   * the last call to Compute. The rejections are only counted when the test
+   * is used, the checked objects when the test or preemptive scoring is used.
+   */
+  size_t
+  GetNumberOfRejectedHypotheses();
+  size_t
+  GetNumberOfVerifiedObjects();
+
+  /**
+   * Set/Get the conditioning threshold of the minimal subsets, 0 (no test)
+   * by default. A subset for which CheckSubSetConditioning of the parameters
+   * estimator fails with this threshold is skipped before its exact
+   * estimate, it counts as an iteration. For the landmark estimator it is
+   * about the squared ratio of the smallest to the largest extent of the
+   * points, e.g. 1e-4 rejects triangles flatter than 1:100.
+   */
+  void
+  SetDegeneracyThreshold(double threshold);
+  double
+  GetDegeneracyThreshold();
+
+  /** Number of minimal subsets skipped by the conditioning test during the
+   * last call to Compute. */
+  size_t
+  GetNumberOfDegenerateSubSets();
+
+  /**
+   * Enable the local optimization of LO-RANSAC (Chum, Matas and Kittler,
+   * "Locally Optimized RANSAC", DAGM 2003). Whenever a hypothesis becomes
+   * the best model, the thread that found it refines it without holding any
+   * lock: an iterated least squares fit to its inliers, followed by an inner
+   * RANSAC of least squares fits to random subsets of the inliers. The
+   * refined model replaces the best one if it has more support, which
+   * tightens the adaptive termination bound earlier. The inliers are built
+   * from the correspondences found by the inlier test, no extra nearest
+   * neighbour search is needed. Disabled by default.
+   */
+  void
+  SetUseLocalOptimization(bool flag);
+  bool
+  GetUseLocalOptimization();
+
+  /** Set/Get the number of inner RANSAC iterations of the local
+   * optimization, default 10. */
+  void
+  SetNumberOfLocalOptimizationIterations(unsigned int iterations);
+  unsigned int
+  GetNumberOfLocalOptimizationIterations();
+
+  /** Number of local optimizations run during the last call to Compute. */
+  size_t
+  GetNumberOfLocalOptimizations();
+
+  /**
+   * Enable preemptive scoring (Nister, "Preemptive RANSAC for Live Structure
+   * and Motion Estimation", ICCV 2003), for a bounded run time instead of a
+   * probability of success. MaxIteration hypotheses are generated up front
+   * and scored on successive blocks of the agree data, in a random order
+   * fixed for each call to Compute. After each block only the best
+   * fraction of the remaining hypotheses is kept, until one remains or the
+   * agree data are exhausted, so the number of inlier tests does not depend
+   * on the data. The winner is then checked against all the agree data.
+   * desiredProbabilityForNoOutliers, the sequential test and the local
+   * optimization are not used in this mode. Disabled by default.
+   */
+  void
+  SetUsePreemptiveScoring(bool flag);
+  bool
+  GetUsePreemptiveScoring();
+
+  /** Set/Get the number of agree objects scored per block, default 100. */
+  void
+  SetPreemptionBlockSize(unsigned int size);
+  unsigned int
+  GetPreemptionBlockSize();
+
+  /** Set/Get the fraction of the hypotheses kept after each block, in
+   * (0,1), default 0.5 as in the paper. */
+  void
+  SetPreemptionRetainedFraction(double fraction);
+  double
+  GetPreemptionRetainedFraction();
+
   /**
    * Set the function object that is able to estimate the desired parametric
    * entity (e.g. PlaneParametersEstimator).
@@ -126,6 +374,84 @@ public:
   void
   SetAgreeData(std::vector<T> & data);
 
+  /**
+   * Set/Get the strategy for drawing the minimal subsets, Uniform by default.
+   *
+   * PROSAC (Chum and Matas, "Matching with PROSAC - Progressive Sample
+   * Consensus", CVPR 2005) ranks the data objects by quality and draws the
+   * k'th hypothesis from the best n(k) objects only, always including the
+   * n(k)'th one, where n(k) grows with the schedule of the paper. Once the
+   * schedule reaches all the data, after about ProgressiveSamplingMaxSamples
+   * hypotheses, the sampling is uniform. Besides the standard adaptive
+   * termination the search stops by the PROSAC criterion: once enough
+   * hypotheses were drawn to find an outlier free subset among the best n
+   * objects with the desired probability, for any n whose number of inliers
+   * is unlikely for a wrong model.
+   *
+   * Compatible draws a seed and then every further object uniformly among
+   * the data compatible with all the objects drawn so far, under the edge
+   * length ratio of SetCheckCorrespondenceEdgeLength, which must be set.
+   * Subsets that would fail the edge length test are never drawn nor
+   * estimated, and the test is skipped. The compatibility of all pairs is
+   * kept as bitsets, n^2/8 bytes for n data objects, computed once per
+   * Compute.
+   */
+  void
+  SetSamplingStrategy(SamplingStrategy strategy);
+  SamplingStrategy
+  GetSamplingStrategy();
+
+  /**
+   * Set/Get the number of neighbours NAPSAC draws from, 16 by default.
+   *
+   * NAPSAC (Myatt et al., "NAPSAC: High Noise, High Dimensional Robust
+   * Estimation - it's in the Bag", BMVC 2002) draws a seed data object
+   * uniformly and the rest of the subset from its nearest neighbours, found
+   * with a kd-tree over the fixed points data[i][0..2]. Inliers of a rigid
+   * part cluster in space, so such subsets are all inliers far more often
+   * than uniform ones and pass the edge length test more often. The
+   * neighbourhoods are computed once per Compute.
+   */
+  void
+  SetNeighborhoodSize(unsigned int size);
+  unsigned int
+  GetNeighborhoodSize();
+
+  /**
+   * Set the quality of each data object (e.g. the negated descriptor distance
+   * of a putative match), larger is better. Used by PROSAC, which takes the
+   * data to be sorted best first if no quality is given. Must be called
+   * after SetData, the quality is cleared by SetData.
+   */
+  void
+  SetDataQuality(const std::vector<double> & quality);
+
+  /**
+   * Set/Get the compatibility prefilter, None by default.
+   *
+   * Before any hypothesis is drawn the data are reduced to a large clique of
+   * their pairwise compatibility graph, built from the edge length ratio of
+   * SetCheckCorrespondenceEdgeLength, which must be set (see
+   * CompatibilityGraph). The correct matches are compatible with each other
+   * whatever the outlier ratio, so the clique is mostly inliers even when
+   * uniform sampling would hardly ever draw an outlier free subset. RANSAC
+   * then runs on the clique alone, or LeastSquares fits it directly. If the
+   * clique is smaller than a minimal subset all the data are used as
+   * without the prefilter, and LeastSquares falls back to RANSAC on the
+   * clique if the fit fails. The agree data are not filtered, and the
+   * adaptive termination still uses the inlier ratio of the agree data, so
+   * a small MaxIteration suits the run on the clique.
+   */
+  void
+  SetCompatibilityPrefilter(CompatibilityPrefilter prefilter);
+  CompatibilityPrefilter
+  GetCompatibilityPrefilter();
+
+  /** Number of data objects in the clique of the last call to Compute, 0
+   * without the prefilter. */
+  size_t
+  GetCompatibleSetSize();
+
   /**
    * Estimate the model parameters using the RANSAC framework.
    * @param parameters A vector which will contain the estimated parameters.
@@ -141,6 +467,16 @@ public:
    * @param desiredProbabilityForNoOutliers The probability that at least one of
    *                                        the selected subsets doesn't contain
    *                                        an outlier, must be in (0,1).
+   *                                        Each time a larger consensus set is
+   *                                        found the required number of
+   *                                        hypotheses is recomputed as
+   *                                        log(1-p)/log(1-w^m), where w is the
+   *                                        fraction of agree data supporting the
+   *                                        best model, and the search stops as
+   *                                        soon as that many were tried.
+   * With the MAGSAC scoring method of the parameters estimator the least
+   * squares estimate is followed by the sigma-consensus fit, iteratively
+   * reweighted least squares with the marginalized inlier weights.
    * @return Returns the percentage of data used in the least squares estimate.
    */
   std::vector<double>
@@ -182,59 +518,371 @@ private:
   unsigned int
   Choose(unsigned int n, unsigned int m);
 
-  class SubSetIndexComparator
+  static ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION
+  RANSACThreadCallback(void * arg);
+
+  /**
+   * Scratch state of a thread computing hypotheses, kept over all the
+   * iterations it runs.
+   */
+  struct HypothesisWorker
   {
-  private:
-    int length;
-
-  public:
-    SubSetIndexComparator(int arrayLength)
-      : length(arrayLength)
-    {}
-    bool
-    operator()(const int * arr1, const int * arr2) const
-    {
-      for (int i = 0; i < this->length; i++)
-      {
-        if (arr1[i] < arr2[i])
-          return true;
-        else if (arr1[i] > arr2[i])
-          return false;
-      }
-      return false;
-    }
+    std::vector<T *>                  exactEstimateData;
+    std::vector<SType>                exactEstimateParameters;
+    // indexes of the objects chosen for the exact fit, in ascending order
+    std::vector<unsigned int>         subSetIndexes;
+    // distances of the agree data objects to the current model
+    std::vector<double>               agreement;
+    SubSetSampler                     subSetSampler;
+    CounterBasedRandomNumberGenerator randomGenerator;
+    // snapshot of the shared sequential test and the epoch it was published
+    // in, refreshed without the lock once a newer one is published
+    SequentialProbabilityRatioTest    localTest;
+    uint64_t                          localTestEpoch = std::numeric_limits<uint64_t>::max();
+    unsigned int                      numberOfTested = 0;
+    // counts of the sequential test not merged into the shared one yet: the
+    // objects checked, the rejected models and the objects checked and
+    // found consistent while verifying them
+    size_t                            pendingVerifiedObjects = 0;
+    unsigned int                      pendingRejectedHypotheses = 0;
+    unsigned int                      pendingRejectedConsistent = 0;
+    unsigned int                      pendingRejectedTested = 0;
+    // matched agree object of each checked object and the inliers, kept for
+    // the local optimization
+    std::vector<unsigned int>         correspondences;
+    std::vector<T>                    inlierData;
+    // best model found by the thread, its inliers as ascending indexes of
+    // the agree data
+    unsigned int                      bestNumVotes = 0;
+    double                            bestScore = 0.0;
+    double                            bestResidual = std::numeric_limits<double>::max();
+    uint64_t                          bestHypothesis = std::numeric_limits<uint64_t>::max();
+    std::vector<SType>                bestParameters;
+    std::vector<unsigned int>         bestInliers;
+    // which data objects agree with a new best model, for PROSAC
+    std::vector<char>                 progressiveAgreement;
   };
 
-  static ITK_THREAD_RETURN_FUNCTION_CALL_CONVENTION
-  RANSACThreadCallback(void * arg);
+  /** Prepare a worker for a new run, forgetting its best model. */
+  void
+  InitializeWorker(HypothesisWorker & worker);
+
+  /**
+   * Add the pending counts of the sequential test of a worker to the shared
+   * test and publish it if delta changed. Must be called while holding
+   * resultsMutex or once the threads are done.
+   */
+  void
+  MergeSequentialTestCounts(HypothesisWorker & worker);
+
+  /**
+   * Publish a copy of the shared sequential test for the workers under a new
+   * epoch. Must be called while holding resultsMutex.
+   */
+  void
+  PublishSequentialTest();
+
+  /** Copy the published sequential test to the worker if it changed. */
+  void
+  RefreshSequentialTest(HypothesisWorker & worker);
+
+  /**
+   * Make the best model of all the workers the result, after they are done,
+   * with the pending counts of their sequential tests.
+   */
+  void
+  ReduceWorkers();
+
+  /**
+   * Models are ordered by score, then by residual, the smaller the better,
+   * then by hypothesis, which breaks ties whatever the thread order.
+   */
+  static bool
+  IsBetterModel(double   score,
+                double   residual,
+                uint64_t hypothesis,
+                double   bestScore,
+                double   bestResidual,
+                uint64_t bestHypothesis)
+  {
+    return score > bestScore || (score == bestScore && residual < bestResidual) ||
+           (score == bestScore && residual == bestResidual && hypothesis < bestHypothesis);
+  }
+
+  /**
+   * Generate and score the hypotheses of the iterations [iterationBegin,
+   * iterationEnd), stopping at the number of tries, and update the best
+   * model.
+   * @param stream Bits or-ed to the iteration number to identify the random
+   *               stream of a hypothesis.
+   * @return The number of iterations run.
+   */
+  unsigned int
+  ProcessIterations(HypothesisWorker & worker, unsigned int iterationBegin, unsigned int iterationEnd, uint64_t stream);
+
+#ifdef ITK_USE_TBB
+  /** Run all the iterations as TBB tasks, see SetUseTaskBasedExecution. */
+  void
+  ComputeTaskBased();
+#endif
+
+  /**
+   * Agree data object index with its moving point replaced by the one of the
+   * agree data object it was matched to.
+   */
+  T
+  MakeInlierObject(unsigned int index, unsigned int correspondence);
+
+  /**
+   * Local optimization of a new best model given its inliers in
+   * worker.inlierData, see SetUseLocalOptimization. Called without holding
+   * resultsMutex. The refined model becomes the best of the worker, the
+   * shared best is updated under the lock and the sequential test published
+   * again if the model is better.
+   */
+  void
+  LocalOptimization(HypothesisWorker & worker,
+                    unsigned int       numVotes,
+                    double             score,
+                    double             residual,
+                    uint64_t           hypothesis);
+
+  /**
+   * Sigma-consensus fit of MAGSAC++: weighted least squares to the inliers
+   * of the parameters, weighted as the scoring policy of the parameters
+   * estimator does, repeated while the score grows.
+   * @param parameters The model to start from, replaced by the best fit.
+   */
+  void
+  SigmaConsensusEstimate(std::vector<SType> & parameters);
+
+  /**
+   * Prepare the sampling strategy for a new run: the ranking of the data
+   * and the growth schedule of PROSAC, the neighbourhoods of NAPSAC or the
+   * compatibility bitsets.
+   */
+  void
+  InitializeSampling(itk::MultiThreaderBase * threader);
+
+  /**
+   * PROSAC termination: lower the shared number of tries given a new best
+   * model, using the inlier ratios of the best n data objects for every n
+   * with a non-random number of inliers. The inliers of the data are found
+   * without holding resultsMutex, the lock is only taken to lower the
+   * number of tries.
+   * @param probabilityOfAcceptance Probability that the sequential test
+   *                                accepts a good model, 1 without it.
+   */
+  void
+  UpdateProgressiveNumberOfTries(std::vector<SType> & parameters,
+                                 double               probabilityOfAcceptance,
+                                 std::vector<char> &  agree);
+
+  /**
+   * Draw the subset of the given iteration, estimate the model parameters
+   * from it and run the inexpensive tests.
+   * @return false if the subset was drawn before, is degenerate or the model
+   *         fails a test.
+   */
+  bool
+  GenerateHypothesis(size_t                              iteration,
+                     CounterBasedRandomNumberGenerator & randomGenerator,
+                     SubSetSampler &                     subSetSampler,
+                     unsigned int *                      subSetIndexes,
+                     std::vector<T *> &                  estimateData,
+                     std::vector<SType> &                parameters);
+
+  /**
+   * Make parameters the best model, with its votes, score and residual on
+   * all the agree data.
+   */
+  void
+  SetBestModel(const std::vector<SType> & parameters, uint64_t hypothesis);
+
+  /**
+   * Reduce the data, and their quality if given, to the clique of the
+   * compatibility graph, see SetCompatibilityPrefilter. The full data and
+   * quality are moved to allData and allDataQuality.
+   * @return false if the clique is smaller than a minimal subset, the data
+   *         are then unchanged.
+   */
+  bool
+  ApplyCompatibilityPrefilter(itk::MultiThreaderBase * threader,
+                              std::vector<T> &         allData,
+                              std::vector<double> &    allDataQuality);
+
+  /**
+   * Preemptive RANSAC, see SetUsePreemptiveScoring. Sets the best model and
+   * its votes like the thread callbacks.
+   */
+  void
+  ComputePreemptive(itk::MultiThreaderBase * threader);
+
+  /**
+   * Subset of the given rank in the combinatorial number system, the
+   * indexes c_m > ... > c_1 with subSetRank = sum C(c_k, k), written in
+   * ascending order.
+   */
+  void
+  UnrankSubSet(size_t subSetRank, unsigned int * indexes);
+
+  /**
+   * Draw the minimal subset of the given iteration, the indexes are sorted
+   * in ascending order.
+   * @return false if no subset was drawn, only with Compatible sampling.
+   */
+  bool
+  DrawSubSet(size_t                              iteration,
+             CounterBasedRandomNumberGenerator & randomGenerator,
+             SubSetSampler &                     subSetSampler,
+             unsigned int *                      indexes);
+
+  /**
+   * Claim the next range of iterations [iterationBegin, iterationEnd) for the
+   * calling thread, either from the global budget or from the thread's own
+   * budget tracked in localIterations. Returns false when the budget is
+   * exhausted.
+   */
+  bool
+  ClaimIterations(size_t & localIterations, unsigned int & iterationBegin, unsigned int & iterationEnd);
+
+  /**
+   * Lower the shared number of tries using the standard adaptive termination
+   * rule, given the number of votes for the new best model. With the
+   * sequential test the probability of drawing an outlier free subset is
+   * scaled by the probability that the test accepts a good model. Must be
+   * called while holding resultsMutex.
+   */
+  void
+  UpdateNumberOfTries(unsigned int numVotesForBest, unsigned int numAgreeObjects, unsigned int numForEstimate);
 
-  // number of threads used in computing the RANSAC hypotheses
-  unsigned int numberOfThreads;
+  // number of threads used in computing the RANSAC hypotheses and the
+  // threader they run on, kept between calls
+  unsigned int                    numberOfThreads;
+  itk::MultiThreaderBase::Pointer multiThreader;
   unsigned int maxIteration;
+  bool         useGlobalIterationBudget;
+  unsigned int iterationChunkSize;
+  bool         useTaskBasedExecution;
+  uint64_t     randomSeed;
+
+  // exhaustive enumeration, requested and in use by the current call, and
+  // binomials[k * (n + 1) + c] = C(c, k) for the unranking
+  bool                  useExhaustiveEnumeration;
+  bool                  enumerating;
+  std::vector<uint64_t> binomials;
+
+  // sequential probability ratio test, the shared state is guarded by
+  // resultsMutex, the workers read the copy published with its epoch
+  bool                                                  useSequentialProbabilityRatioTest;
+  double                                                sprtInlierRatio;
+  double                                                sprtBadModelInlierRatio;
+  double                                                sprtTimeRatio;
+  SequentialProbabilityRatioTest                        sprt;
+  std::shared_ptr<const SequentialProbabilityRatioTest> sprtSnapshot;
+  std::atomic<uint64_t>                                 sprtEpoch;
+  // a worker merges its rejected models into the shared test after this
+  // many, or when it finds a new best model
+  static constexpr unsigned int SequentialTestMergeInterval = 64;
+  // the agree data in the random order the test checks them in, and the
+  // index of each object in agreeData
+  std::vector<T>                 shuffledAgreeData;
+  std::vector<unsigned int>      agreeDataOrder;
+  size_t                         numberOfRejectedHypotheses;
+  size_t                         numberOfVerifiedObjects;
+
+  // conditioning test of the minimal subsets, the counter is updated by all
+  // threads
+  double              degeneracyThreshold;
+  std::atomic<size_t> numberOfDegenerateSubSets;
+
+  // sampling strategy, PROSAC ranks the data by quality, data[rank[i]] is
+  // the i'th best object, and progressiveGrowth[n] is the last iteration
+  // (counted from one) drawing from the best n objects
+  SamplingStrategy          samplingStrategy;
+  std::vector<double>       dataQuality;
+  std::vector<unsigned int> rank;
+  std::vector<size_t>       progressiveGrowth;
+  // least number of inliers among the best n objects for a model to be
+  // considered non-random by the PROSAC termination
+  std::vector<unsigned int> progressiveMinimumInliers;
+  // number of hypotheses after which PROSAC samples uniformly, the value of
+  // the paper
+  static constexpr double ProgressiveSamplingMaxSamples = 200000.0;
+  // probability that a data object supports a wrong model, used for the
+  // non-randomness test
+  static constexpr double ProgressiveSamplingBadModelInlierRatio = 0.05;
+  // NAPSAC, the neighbours of data[i] are
+  // neighbors[i * neighborsPerObject .. (i + 1) * neighborsPerObject)
+  unsigned int              neighborhoodSize;
+  unsigned int              neighborsPerObject;
+  std::vector<unsigned int> neighbors;
+  // compatible sampling, the bitset of data[i] is the words
+  // compatibleSets[i * compatibleSetWords .. (i + 1) * compatibleSetWords),
+  // the seeds are the objects compatible with enough others for a subset
+  std::vector<uint64_t>     compatibleSets;
+  size_t                    compatibleSetWords;
+  std::vector<unsigned int> compatibleSeeds;
+
+  // compatibility prefilter
+  CompatibilityPrefilter compatibilityPrefilter;
+  size_t                 compatibleSetSize;
+
+  // preemptive scoring
+  bool         usePreemptiveScoring;
+  unsigned int preemptionBlockSize;
+  double       preemptionRetainedFraction;
+
+  // local optimization (LO-RANSAC)
+  bool         useLocalOptimization;
+  unsigned int numberOfLocalOptimizationIterations;
+  size_t       numberOfLocalOptimizations;
+  // least squares refits per iterated least squares run, and size of the
+  // inner RANSAC samples in multiples of the minimal sample size
+  static constexpr unsigned int LocalOptimizationLeastSquaresIterations = 4;
+  static constexpr unsigned int LocalOptimizationSampleFactor = 4;
+  // reweighted fits of the sigma-consensus
+  static constexpr unsigned int SigmaConsensusIterations = 10;
 
   // the following variables are shared by all threads used in the RANSAC
   // computation
 
-  // array corresponding to length of data array, data[i]== true if it
-  // agrees with the best model, otherwise false
-  bool *       bestVotes;
-  unsigned int numVotesForBest;
-  double       bestRMSE;
+  // every thread keeps its best model in its worker, the best of them is
+  // the result
+  std::vector<HypothesisWorker> workers;
+  // indexes of the agree data objects that agree with the best model, in
+  // ascending order, filled once the threads are done
+  std::vector<unsigned int> bestInliers;
+  // the best model over all threads so far, guarded by resultsMutex: its
+  // number of inliers for the adaptive termination, its score, also read
+  // without the lock as the bound that stops the evaluation of a hypothesis
+  // early and keeps the threads off the lock unless they may beat it, the
+  // sum of the squared distances of its inliers and its random stream, which
+  // breaks ties deterministically
+  unsigned int        numVotesForBest;
+  std::atomic<double> bestScore;
+  double              bestResidual;
+  uint64_t            bestHypothesis;
 
   std::vector<T> data;
   std::vector<T> agreeData;
   std::vector<double> parametersRansac;
 
-  // set which holds all of the subgroups/hypotheses already selected
-  std::set<int *, SubSetIndexComparator> * chosenSubSets;
-  // number of iterations, equivalent to desired number of hypotheses
-  unsigned int numTries;
+  // fingerprints of all the subgroups/hypotheses already selected
+  SubSetFingerprintTable chosenSubSets;
+  // number of iterations, equivalent to desired number of hypotheses. All
+  // threads share this bound, it is lowered whenever a larger consensus set
+  // is found (adaptive termination).
+  std::atomic<unsigned int> numTries;
+  // next iteration to be claimed from the global budget
+  std::atomic<size_t> nextIteration;
+  // number of iterations performed by all threads
+  std::atomic<size_t> numberOfIterations;
 
   double       numerator;
   unsigned int allTries;
 
   typename ParametersEstimator<T, SType>::Pointer paramEstimator;
-  std::mutex                                  hypothesisMutex;
   std::mutex                                  resultsMutex;
 };
 
@@ -31,6 +31,35 @@ template <typename T,  typename SType, typename TTransform>
 RANSAC<T, SType, TTransform>::RANSAC()
 {
   this->numberOfThreads = 1;
+  this->maxIteration = std::numeric_limits<unsigned int>::max();
+  this->useGlobalIterationBudget = false;
+  this->useExhaustiveEnumeration = false;
+  this->enumerating = false;
+  this->iterationChunkSize = 16;
+  this->useTaskBasedExecution = false;
+  this->randomSeed = 0;
+  this->numberOfIterations = 0;
+  this->useSequentialProbabilityRatioTest = false;
+  this->sprtInlierRatio = 0.02;
+  this->sprtBadModelInlierRatio = 0.002;
+  this->sprtTimeRatio = 50.0;
+  this->sprtEpoch = 0;
+  this->numberOfRejectedHypotheses = 0;
+  this->numberOfVerifiedObjects = 0;
+  this->degeneracyThreshold = 0.0;
+  this->numberOfDegenerateSubSets = 0;
+  this->useLocalOptimization = false;
+  this->numberOfLocalOptimizationIterations = 10;
+  this->numberOfLocalOptimizations = 0;
+  this->samplingStrategy = SamplingStrategy::Uniform;
+  this->neighborhoodSize = 16;
+  this->neighborsPerObject = 0;
+  this->compatibleSetWords = 0;
+  this->usePreemptiveScoring = false;
+  this->preemptionBlockSize = 100;
+  this->preemptionRetainedFraction = 0.5;
+  this->compatibilityPrefilter = CompatibilityPrefilter::None;
+  this->compatibleSetSize = 0;
 }
 
 
@@ -56,6 +85,293 @@ RANSAC<T, SType, TTransform>::SetMaxIteration(unsigned int inputMaxIteration)
   this->maxIteration = inputMaxIteration;
 }
 
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUseGlobalIterationBudget(bool globalBudget)
+{
+  this->useGlobalIterationBudget = globalBudget;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUseGlobalIterationBudget()
+{
+  return this->useGlobalIterationBudget;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetIterationChunkSize(unsigned int chunkSize)
+{
+  if (chunkSize == 0)
+    throw ExceptionObject(__FILE__, __LINE__, "Invalid setting for iteration chunk size.");
+
+  this->iterationChunkSize = chunkSize;
+}
+
+template <typename T,  typename SType, typename TTransform>
+unsigned int
+RANSAC<T, SType, TTransform>::GetIterationChunkSize()
+{
+  return this->iterationChunkSize;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUseTaskBasedExecution(bool flag)
+{
+  this->useTaskBasedExecution = flag;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUseTaskBasedExecution()
+{
+  return this->useTaskBasedExecution;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUseExhaustiveEnumeration(bool flag)
+{
+  this->useExhaustiveEnumeration = flag;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUseExhaustiveEnumeration()
+{
+  return this->useExhaustiveEnumeration;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetRandomSeed(uint64_t seed)
+{
+  this->randomSeed = seed;
+}
+
+template <typename T,  typename SType, typename TTransform>
+uint64_t
+RANSAC<T, SType, TTransform>::GetRandomSeed()
+{
+  return this->randomSeed;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetNumberOfIterations()
+{
+  return this->numberOfIterations;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetSamplingStrategy(SamplingStrategy strategy)
+{
+  this->samplingStrategy = strategy;
+}
+
+template <typename T,  typename SType, typename TTransform>
+auto
+RANSAC<T, SType, TTransform>::GetSamplingStrategy() -> SamplingStrategy
+{
+  return this->samplingStrategy;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetNeighborhoodSize(unsigned int size)
+{
+  if (size == 0)
+    throw ExceptionObject(__FILE__, __LINE__, "The NAPSAC neighborhood size must be positive.");
+  this->neighborhoodSize = size;
+}
+
+template <typename T,  typename SType, typename TTransform>
+unsigned int
+RANSAC<T, SType, TTransform>::GetNeighborhoodSize()
+{
+  return this->neighborhoodSize;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetDataQuality(const std::vector<double> & quality)
+{
+  if (quality.size() != this->data.size())
+    throw ExceptionObject(__FILE__, __LINE__, "The number of quality values does not match the number of data objects.");
+  this->dataQuality = quality;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetCompatibilityPrefilter(CompatibilityPrefilter prefilter)
+{
+  this->compatibilityPrefilter = prefilter;
+}
+
+template <typename T,  typename SType, typename TTransform>
+auto
+RANSAC<T, SType, TTransform>::GetCompatibilityPrefilter() -> CompatibilityPrefilter
+{
+  return this->compatibilityPrefilter;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetCompatibleSetSize()
+{
+  return this->compatibleSetSize;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUsePreemptiveScoring(bool flag)
+{
+  this->usePreemptiveScoring = flag;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUsePreemptiveScoring()
+{
+  return this->usePreemptiveScoring;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetPreemptionBlockSize(unsigned int size)
+{
+  if (size == 0)
+    throw ExceptionObject(__FILE__, __LINE__, "The preemption block size must be positive.");
+  this->preemptionBlockSize = size;
+}
+
+template <typename T,  typename SType, typename TTransform>
+unsigned int
+RANSAC<T, SType, TTransform>::GetPreemptionBlockSize()
+{
+  return this->preemptionBlockSize;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetPreemptionRetainedFraction(double fraction)
+{
+  if (!(fraction > 0.0 && fraction < 1.0))
+    throw ExceptionObject(__FILE__, __LINE__, "The retained fraction must be in (0,1).");
+  this->preemptionRetainedFraction = fraction;
+}
+
+template <typename T,  typename SType, typename TTransform>
+double
+RANSAC<T, SType, TTransform>::GetPreemptionRetainedFraction()
+{
+  return this->preemptionRetainedFraction;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUseSequentialProbabilityRatioTest(bool flag)
+{
+  this->useSequentialProbabilityRatioTest = flag;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUseSequentialProbabilityRatioTest()
+{
+  return this->useSequentialProbabilityRatioTest;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetSequentialProbabilityRatioTestParameters(double inlierRatio,
+                                                                          double badModelInlierRatio,
+                                                                          double timeRatio)
+{
+  if (inlierRatio <= 0.0 || inlierRatio >= 1.0 || badModelInlierRatio <= 0.0 || badModelInlierRatio >= inlierRatio ||
+      timeRatio <= 0.0)
+    throw ExceptionObject(__FILE__, __LINE__, "Invalid setting for the sequential probability ratio test.");
+
+  this->sprtInlierRatio = inlierRatio;
+  this->sprtBadModelInlierRatio = badModelInlierRatio;
+  this->sprtTimeRatio = timeRatio;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetNumberOfRejectedHypotheses()
+{
+  return this->numberOfRejectedHypotheses;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetNumberOfVerifiedObjects()
+{
+  return this->numberOfVerifiedObjects;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetDegeneracyThreshold(double threshold)
+{
+  if (!(threshold >= 0.0 && threshold < 1.0))
+    throw ExceptionObject(__FILE__, __LINE__, "The degeneracy threshold must be in [0,1).");
+  this->degeneracyThreshold = threshold;
+}
+
+template <typename T,  typename SType, typename TTransform>
+double
+RANSAC<T, SType, TTransform>::GetDegeneracyThreshold()
+{
+  return this->degeneracyThreshold;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetNumberOfDegenerateSubSets()
+{
+  return this->numberOfDegenerateSubSets;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetUseLocalOptimization(bool flag)
+{
+  this->useLocalOptimization = flag;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GetUseLocalOptimization()
+{
+  return this->useLocalOptimization;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetNumberOfLocalOptimizationIterations(unsigned int iterations)
+{
+  this->numberOfLocalOptimizationIterations = iterations;
+}
+
+template <typename T,  typename SType, typename TTransform>
+unsigned int
+RANSAC<T, SType, TTransform>::GetNumberOfLocalOptimizationIterations()
+{
+  return this->numberOfLocalOptimizationIterations;
+}
+
+template <typename T,  typename SType, typename TTransform>
+size_t
+RANSAC<T, SType, TTransform>::GetNumberOfLocalOptimizations()
+{
+  return this->numberOfLocalOptimizations;
+}
+
 template <typename T,  typename SType, typename TTransform>
 void
 RANSAC<T, SType, TTransform>::SetCheckCorresspondenceDistance(bool inputFlag)
@@ -92,6 +408,22 @@ RANSAC<T, SType, TTransform>::GetNumberOfThreads()
   return this->numberOfThreads;
 }
 
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetMultiThreader(itk::MultiThreaderBase * threader)
+{
+  this->multiThreader = threader;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+itk::MultiThreaderBase *
+RANSAC<T, SType, TTransform>::GetMultiThreader()
+{
+  return this->multiThreader;
+}
+
 template <typename T,  typename SType, typename TTransform>
 void
 RANSAC<T, SType, TTransform>::SetParametersEstimator(ParametersEstimatorType * inputParamEstimator)
@@ -117,6 +449,7 @@ RANSAC<T, SType, TTransform>::SetData(std::vector<T> & inputData)
     if (inputData.size() < this->paramEstimator->GetMinimalForEstimate())
       throw ExceptionObject(__FILE__, __LINE__, "Not enough data elements for use with the parameter estimator.");
   this->data = inputData;
+  this->dataQuality.clear();
 }
 
 template <typename T,  typename SType, typename TTransform>
@@ -149,54 +482,175 @@ RANSAC<T, SType, TTransform>::Compute(std::vector<SType> & parameters, double de
         outputPair.push_back(0);
         return outputPair;
       }
+  if (this->compatibilityPrefilter != CompatibilityPrefilter::None && !(this->checkCorrespondenceEdgeLengthTest > 0))
+    throw ExceptionObject(__FILE__, __LINE__, "The compatibility prefilter needs the edge length ratio.");
+
+  // the pool outlives the call, only its number of work units changes
+  if (this->multiThreader.IsNull())
+    this->multiThreader = itk::PoolMultiThreader::New().GetPointer();
+  itk::MultiThreaderBase::Pointer threader = this->multiThreader;
+  threader->SetMaximumNumberOfThreads(this->numberOfThreads);
+  threader->SetNumberOfWorkUnits(this->numberOfThreads);
+
+  // with the prefilter the data are the clique during this call, the full
+  // data are restored when it returns or throws
+  struct PrefilterRestorer
+  {
+    std::vector<T> &      data;
+    std::vector<double> & dataQuality;
+    std::vector<T>        allData;
+    std::vector<double>   allDataQuality;
+    bool                  prefiltered = false;
 
+    ~PrefilterRestorer()
+    {
+      if (this->prefiltered)
+      {
+        this->data.swap(this->allData);
+        this->dataQuality.swap(this->allDataQuality);
+      }
+    }
+  } restorer{ this->data, this->dataQuality };
+  this->compatibleSetSize = 0;
+  if (this->compatibilityPrefilter != CompatibilityPrefilter::None)
+    restorer.prefiltered = this->ApplyCompatibilityPrefilter(threader, restorer.allData, restorer.allDataQuality);
+  const bool prefiltered = restorer.prefiltered;
 
   unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
   size_t       numAgreeObjects = this->agreeData.size();
   size_t       numDataObjects = this->data.size();
 
-  this->bestVotes = new bool[numAgreeObjects];
+  this->bestInliers.clear();
   // initalize with 0 so that the first computation which gives
   // any type of fit will be set to best
   this->numVotesForBest = 0;
+  this->bestScore = 0.0;
+  this->bestResidual = std::numeric_limits<double>::max();
+  this->bestHypothesis = std::numeric_limits<uint64_t>::max();
+  this->parametersRansac.clear();
 
-  SubSetIndexComparator subSetIndexComparator(numForEstimate);
-  this->chosenSubSets = new std::set<int *, SubSetIndexComparator>(subSetIndexComparator);
   // initialize with the number of all possible subsets
   this->allTries = Choose(numDataObjects, numForEstimate);
   this->numTries = this->allTries;
-  //this->
+
+  // at most this many subsets are drawn, the table records no more of them
+  // and only allocates for the ones it records
+#ifdef ITK_USE_TBB
+  const bool taskBased = this->useTaskBasedExecution;
+#else
+  const bool taskBased = false;
+#endif
+  size_t maxSubSets = this->maxIteration;
+  if (!this->useGlobalIterationBudget && !taskBased)
+    maxSubSets *= this->numberOfThreads;
+  // Choose saturates, a saturated count is never enumerated
+  this->enumerating = this->useExhaustiveEnumeration && !this->usePreemptiveScoring &&
+                      this->allTries < std::numeric_limits<unsigned int>::max() && this->allTries <= maxSubSets;
+  this->binomials.clear();
+  if (this->enumerating)
+  {
+    // Pascal's triangle, C(c, k) for c <= n and k <= m, saturated, the
+    // unranking only compares them with ranks below C(n, m)
+    const size_t columns = numDataObjects + 1;
+    this->binomials.assign((numForEstimate + 1) * columns, 0);
+    for (size_t c = 0; c < columns; ++c)
+    {
+      this->binomials[c] = 1;
+      for (size_t k = 1; k <= numForEstimate && k <= c; ++k)
+      {
+        const uint64_t a = this->binomials[(k - 1) * columns + c - 1];
+        const uint64_t b = this->binomials[k * columns + c - 1];
+        this->binomials[k * columns + c] = a + b < a ? std::numeric_limits<uint64_t>::max() : a + b;
+      }
+    }
+  }
+  else
+  {
+    this->chosenSubSets.Initialize(std::min(maxSubSets, (size_t)this->allTries), numForEstimate, numDataObjects);
+    this->InitializeSampling(threader);
+  }
   this->numerator = log(1.0 - desiredProbabilityForNoOutliers);
+  this->nextIteration = 0;
+  this->numberOfIterations = 0;
+  this->numberOfRejectedHypotheses = 0;
+  this->numberOfVerifiedObjects = 0;
+  this->numberOfDegenerateSubSets = 0;
+  this->numberOfLocalOptimizations = 0;
+
+  if (this->useSequentialProbabilityRatioTest)
+  {
+    this->sprt.Initialize(this->sprtInlierRatio, this->sprtBadModelInlierRatio, this->sprtTimeRatio);
+    this->PublishSequentialTest();
+  }
 
-  srand((unsigned)time(NULL)); // seed random number generator
+  if (this->useSequentialProbabilityRatioTest || this->usePreemptiveScoring)
+  {
+    // the sequential test and the preemptive scoring need the agree data in
+    // random order, shuffle them once using a stream no hypothesis uses
+    CounterBasedRandomNumberGenerator randomGenerator;
+    randomGenerator.reset(this->randomSeed, std::numeric_limits<uint64_t>::max());
+    this->agreeDataOrder.resize(numAgreeObjects);
+    for (unsigned int i = 0; i < numAgreeObjects; ++i)
+      this->agreeDataOrder[i] = i;
+    for (size_t i = numAgreeObjects; i > 1; --i)
+      std::swap(this->agreeDataOrder[i - 1], this->agreeDataOrder[randomGenerator.uniformInteger(i)]);
+
+    this->shuffledAgreeData.resize(numAgreeObjects);
+    for (unsigned int i = 0; i < numAgreeObjects; ++i)
+      this->shuffledAgreeData[i] = this->agreeData[this->agreeDataOrder[i]];
+  }
 
   // STEP2: create the threads that generate hypotheses and test
-  itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(this->numberOfThreads);
-  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
-  // runs all threads and blocks till they finish
-  threader->SetSingleMethodAndExecute(RANSAC<T, SType, TTransform>::RANSACThreadCallback, this);
-
-  auto transform = TTransform::New();
-
-  auto optParameters = transform->GetParameters();
-  auto fixedParameters = transform->GetFixedParameters();
-  unsigned int totalParameters = optParameters.GetSize() + fixedParameters.GetSize();
-
-  int counter = 0;
-  for (unsigned int i = optParameters.GetSize(); i < totalParameters; ++i)
+  bool fitted = false;
+  if (prefiltered && this->compatibilityPrefilter == CompatibilityPrefilter::LeastSquares)
+  {
+    std::vector<SType> cliqueParameters;
+    this->paramEstimator->LeastSquaresEstimate(this->data, cliqueParameters);
+    fitted = !cliqueParameters.empty();
+    if (fitted)
+      this->SetBestModel(cliqueParameters, 0);
+  }
+  if (!fitted)
   {
-    fixedParameters.SetElement(counter, this->parametersRansac[i]);
-    counter = counter + 1;
+    if (this->usePreemptiveScoring)
+      this->ComputePreemptive(threader);
+#ifdef ITK_USE_TBB
+    else if (taskBased)
+      this->ComputeTaskBased();
+#endif
+    else
+    {
+      // runs all threads and blocks till they finish
+      this->workers.resize(threader->GetNumberOfWorkUnits());
+      threader->SetSingleMethodAndExecute(RANSAC<T, SType, TTransform>::RANSACThreadCallback, this);
+      this->ReduceWorkers();
+    }
   }
-  transform->SetFixedParameters(fixedParameters);
 
-  counter = 0;
-  for (unsigned int i = 0; i < optParameters.GetSize(); ++i)
+  // the best model, if any hypothesis passed the tests
+  auto transform = TTransform::New();
+  if (this->numVotesForBest > 0)
   {
-    optParameters.SetElement(counter, this->parametersRansac[i]);
-    counter = counter + 1;
+    auto optParameters = transform->GetParameters();
+    auto fixedParameters = transform->GetFixedParameters();
+    unsigned int totalParameters = optParameters.GetSize() + fixedParameters.GetSize();
+
+    int counter = 0;
+    for (unsigned int i = optParameters.GetSize(); i < totalParameters; ++i)
+    {
+      fixedParameters.SetElement(counter, this->parametersRansac[i]);
+      counter = counter + 1;
+    }
+    transform->SetFixedParameters(fixedParameters);
+
+    counter = 0;
+    for (unsigned int i = 0; i < optParameters.GetSize(); ++i)
+    {
+      optParameters.SetElement(counter, this->parametersRansac[i]);
+      counter = counter + 1;
+    }
+    transform->SetParameters(optParameters);
   }
-  transform->SetParameters(optParameters);
 
 
   // STEP3: least squares estimate using largest consensus set and cleanup
@@ -226,55 +680,46 @@ RANSAC<T, SType, TTransform>::Compute(std::vector<SType> & parameters, double de
 
   if (this->numVotesForBest > 0)
   {
-    for (unsigned int j = 0; j < numAgreeObjects; j++)
+    for (unsigned int j : this->bestInliers)
     {
-      if (this->bestVotes[j])
-      {
-        // Find the corresponding point by performing query using KDTree
-        auto tempPoint = this->agreeData[j];
-        testPoint[0] = tempPoint[0];
-        testPoint[1] = tempPoint[1];
-        testPoint[2] = tempPoint[2];
-
-        const size_t num_results = 1;
-        std::vector<size_t> ret_indexes(num_results);
-        std::vector<double> out_dists_sqr(num_results);
-        nanoflann::KNNResultSet<double> resultSet(num_results);
-
-        auto transformedPoint = transform->TransformPoint(testPoint);
-        auto pointId = pointsLocator->FindClosestPoint(transformedPoint);
-        auto corresPoint = points->GetElement(pointId);
-
-        // Insert the corresponding point for leastSquaresEstimate
-        inlierPoint[0] = tempPoint[0];
-        inlierPoint[1] = tempPoint[1];
-        inlierPoint[2] = tempPoint[2];
-        inlierPoint[3] = corresPoint[0];
-        inlierPoint[4] = corresPoint[1];
-        inlierPoint[5] = corresPoint[2];
-
-        leastSquaresEstimateData.push_back(inlierPoint);
-      }
+      // Find the corresponding point by performing query using KDTree
+      auto tempPoint = this->agreeData[j];
+      testPoint[0] = tempPoint[0];
+      testPoint[1] = tempPoint[1];
+      testPoint[2] = tempPoint[2];
+
+      const size_t num_results = 1;
+      std::vector<size_t> ret_indexes(num_results);
+      std::vector<double> out_dists_sqr(num_results);
+      nanoflann::KNNResultSet<double> resultSet(num_results);
+
+      auto transformedPoint = transform->TransformPoint(testPoint);
+      auto pointId = pointsLocator->FindClosestPoint(transformedPoint);
+      auto corresPoint = points->GetElement(pointId);
+
+      // Insert the corresponding point for leastSquaresEstimate
+      inlierPoint[0] = tempPoint[0];
+      inlierPoint[1] = tempPoint[1];
+      inlierPoint[2] = tempPoint[2];
+      inlierPoint[3] = corresPoint[0];
+      inlierPoint[4] = corresPoint[1];
+      inlierPoint[5] = corresPoint[2];
+
+      leastSquaresEstimateData.push_back(inlierPoint);
     }
 
     paramEstimator->LeastSquaresEstimate(leastSquaresEstimateData, parameters);
+    if (paramEstimator->GetScoringMethod() == ParametersEstimatorType::ScoringMethod::MAGSAC)
+      this->SigmaConsensusEstimate(parameters);
   }
 
 
-  // cleanup
-  typename std::set<int *, SubSetIndexComparator>::iterator it = this->chosenSubSets->begin();
-  typename std::set<int *, SubSetIndexComparator>::iterator chosenSubSetsEnd = this->chosenSubSets->end();
-  while (it != chosenSubSetsEnd)
-  {
-    delete[](*it);
-    it++;
-  }
-  this->chosenSubSets->clear();
-  delete this->chosenSubSets;
-  delete[] this->bestVotes;
+  // cleanup, the restorer swaps the full data back
+  this->shuffledAgreeData.clear();
+  this->shuffledAgreeData.shrink_to_fit();
 
   outputPair.push_back((double)this->numVotesForBest / (double)numAgreeObjects);
-  outputPair.push_back(this->bestRMSE);
+  outputPair.push_back(this->bestResidual);
   return outputPair;
 }
 
@@ -290,143 +735,1014 @@ RANSAC<T, SType, TTransform>::RANSACThreadCallback(void * arg)
 
   if (caller != NULL)
   {
-    unsigned int i, k, l, m, maxIndex, numVotesForCur;
-    int          j;
-    int *        curSubSetIndexes;
+    HypothesisWorker & worker = caller->workers[infoStruct->WorkUnitID];
+    caller->InitializeWorker(worker);
+
+    // every hypothesis has its own random stream, with a global budget the
+    // iteration number identifies it, otherwise it is per thread
+    uint64_t stream = 0;
+    if (!caller->useGlobalIterationBudget && !caller->enumerating)
+      stream = (uint64_t)infoStruct->WorkUnitID << 32;
+
+    size_t       localIterations = 0;
+    unsigned int iterationBegin, iterationEnd;
+    while (caller->ClaimIterations(localIterations, iterationBegin, iterationEnd))
+      caller->numberOfIterations += caller->ProcessIterations(worker, iterationBegin, iterationEnd, stream);
+  }
+  return ITK_THREAD_RETURN_DEFAULT_VALUE;
+}
+
+
+#ifdef ITK_USE_TBB
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::ComputeTaskBased()
+{
+  const size_t limit = this->enumerating ? this->allTries : std::min(this->maxIteration, this->numTries.load());
+
+  tbb::enumerable_thread_specific<HypothesisWorker> workers([this]() {
+    HypothesisWorker worker;
+    this->InitializeWorker(worker);
+    return worker;
+  });
+
+  // chunks of at most iterationChunkSize iterations, past the number of
+  // tries a chunk returns at once
+  tbb::task_arena arena(this->numberOfThreads);
+  arena.execute([this, limit, &workers]() {
+    tbb::parallel_for(
+      tbb::blocked_range<unsigned int>(0, static_cast<unsigned int>(limit), this->iterationChunkSize),
+      [this, &workers](const tbb::blocked_range<unsigned int> & range) {
+        this->numberOfIterations += this->ProcessIterations(workers.local(), range.begin(), range.end(), 0);
+      },
+      tbb::simple_partitioner());
+  });
+
+  this->workers.clear();
+  for (auto & worker : workers)
+    this->workers.push_back(std::move(worker));
+  this->ReduceWorkers();
+}
+#endif
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::InitializeWorker(HypothesisWorker & worker)
+{
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  worker.exactEstimateData.resize(numForEstimate);
+  worker.subSetIndexes.resize(numForEstimate);
+  worker.bestNumVotes = 0;
+  worker.bestScore = 0.0;
+  worker.bestResidual = std::numeric_limits<double>::max();
+  worker.bestHypothesis = std::numeric_limits<uint64_t>::max();
+  worker.bestParameters.clear();
+  worker.bestInliers.clear();
+  worker.subSetSampler.Initialize(numForEstimate);
+  worker.pendingVerifiedObjects = 0;
+  worker.pendingRejectedHypotheses = 0;
+  worker.pendingRejectedConsistent = 0;
+  worker.pendingRejectedTested = 0;
+  worker.localTestEpoch = std::numeric_limits<uint64_t>::max();
+  if (this->useSequentialProbabilityRatioTest)
+    this->RefreshSequentialTest(worker);
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::MergeSequentialTestCounts(HypothesisWorker & worker)
+{
+  this->numberOfVerifiedObjects += worker.pendingVerifiedObjects;
+  this->numberOfRejectedHypotheses += worker.pendingRejectedHypotheses;
+  if (worker.pendingRejectedHypotheses > 0)
+  {
+    // the objects checked before the rejections estimate the fraction of the
+    // data supporting a wrong model
+    const double delta = this->sprt.GetBadModelInlierRatio();
+    this->sprt.AddRejectedModel(worker.pendingRejectedConsistent, worker.pendingRejectedTested);
+    if (this->sprt.GetBadModelInlierRatio() != delta)
+      this->PublishSequentialTest();
+  }
+  worker.pendingVerifiedObjects = 0;
+  worker.pendingRejectedHypotheses = 0;
+  worker.pendingRejectedConsistent = 0;
+  worker.pendingRejectedTested = 0;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::PublishSequentialTest()
+{
+  std::atomic_store(&this->sprtSnapshot, std::make_shared<const SequentialProbabilityRatioTest>(this->sprt));
+  this->sprtEpoch.fetch_add(1, std::memory_order_release);
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::RefreshSequentialTest(HypothesisWorker & worker)
+{
+  // the snapshot is stored before the epoch is raised, it is at least as
+  // recent as the epoch read
+  const uint64_t epoch = this->sprtEpoch.load(std::memory_order_acquire);
+  if (epoch == worker.localTestEpoch)
+    return;
+  worker.localTest = *std::atomic_load(&this->sprtSnapshot);
+  worker.localTestEpoch = epoch;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::ReduceWorkers()
+{
+  HypothesisWorker * best = nullptr;
+  for (auto & worker : this->workers)
+  {
+    this->MergeSequentialTestCounts(worker);
+    if (!worker.bestParameters.empty() &&
+        (best == nullptr || IsBetterModel(worker.bestScore,
+                                          worker.bestResidual,
+                                          worker.bestHypothesis,
+                                          best->bestScore,
+                                          best->bestResidual,
+                                          best->bestHypothesis)))
+      best = &worker;
+  }
+  if (best == nullptr)
+    return;
+
+  this->numVotesForBest = best->bestNumVotes;
+  this->bestScore = best->bestScore;
+  this->bestResidual = best->bestResidual;
+  this->bestHypothesis = best->bestHypothesis;
+  this->parametersRansac.assign(best->bestParameters.begin(), best->bestParameters.end());
+  this->bestInliers.swap(best->bestInliers);
+}
+
 
-    unsigned int     numDataObjects = caller->data.size();
-    unsigned int     numAgreeObjects = caller->agreeData.size();
+template <typename T,  typename SType, typename TTransform>
+unsigned int
+RANSAC<T, SType, TTransform>::ProcessIterations(HypothesisWorker & worker,
+                                                unsigned int       iterationBegin,
+                                                unsigned int       iterationEnd,
+                                                uint64_t           stream)
+{
+  unsigned int i, m, numVotesForCur;
+  double       scoreForCur, residual;
 
-    unsigned int     numForEstimate = caller->paramEstimator->GetMinimalForEstimate();
-    std::vector<T *> exactEstimateData;
-    std::vector<SType>   exactEstimateParameters;
+  const unsigned int numAgreeObjects = this->agreeData.size();
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
 
-    // true if agreeData[i] agrees with the current model, otherwise false
-    bool * curVotes = new bool[numAgreeObjects];
-    // true if data[i] is NOT chosen for computing the exact fit, otherwise false
-    bool * notChosen = new bool[numDataObjects];
+  const bool useSPRT = this->useSequentialProbabilityRatioTest;
+  const bool useLO = this->useLocalOptimization;
+  bool       rejected = false;
+  bool       improved;
 
-    unsigned int counter = 0;
-    for (i = 0; i < caller->numTries; i++)
+  uint64_t curHypothesis;
+  // the number of tries may have been lowered after the range was claimed
+  for (i = iterationBegin; i < iterationEnd && i < this->numTries; i++)
+  {
+    curHypothesis = i | stream;
+    worker.randomGenerator.reset(this->randomSeed, curHypothesis);
+
+    if (!this->GenerateHypothesis(i,
+                                  worker.randomGenerator,
+                                  worker.subSetSampler,
+                                  worker.subSetIndexes.data(),
+                                  worker.exactEstimateData,
+                                  worker.exactEstimateParameters))
+      continue;
+
+    // Expensive Inlier Test, without SPRT localTest is never active and
+    // this is a full test, stopped early only by the best score
+    this->paramEstimator->AgreeMultipleSequential(worker.exactEstimateParameters,
+                                                  useSPRT ? this->shuffledAgreeData : this->agreeData,
+                                                  this->bestScore,
+                                                  worker.localTest,
+                                                  rejected,
+                                                  worker.numberOfTested,
+                                                  scoreForCur,
+                                                  numVotesForCur,
+                                                  residual,
+                                                  worker.agreement,
+                                                  useLO ? &worker.correspondences : nullptr);
+    // only the objects checked are written, a rejected model does not cost
+    // a pass over all the agree data
+    const std::vector<double> & result = worker.agreement;
+
+    // the counts of the sequential test stay with the worker, the lock is
+    // only taken to merge them every few rejected models
+    if (useSPRT)
     {
-      counter = counter + 1;
-      if (counter > caller->maxIteration)
-      {
-        break;
-      }
-      // randomly select data for exact model fit ('numForEstimate' objects).
-      std::fill(notChosen, notChosen + numDataObjects, true);
-      curSubSetIndexes = new int[numForEstimate];
-      exactEstimateData.clear();
-      exactEstimateData.reserve(numForEstimate);
-      maxIndex = numDataObjects - 1;
-      for (l = 0; l < numForEstimate; l++)
+      worker.pendingVerifiedObjects += worker.numberOfTested;
+      if (rejected)
       {
-        // selectedIndex is in [0,maxIndex]
-        int selectedIndex = (int)(((float)rand() / (float)RAND_MAX) * maxIndex + 0.5);
-        for (j = -1, k = 0; k < numDataObjects && j < selectedIndex; k++)
+        worker.pendingRejectedHypotheses++;
+        worker.pendingRejectedConsistent += numVotesForCur;
+        worker.pendingRejectedTested += worker.numberOfTested;
+        if (worker.pendingRejectedHypotheses >= SequentialTestMergeInterval)
         {
-          if (notChosen[k])
-            j++;
+          std::lock_guard<std::mutex> lock(this->resultsMutex);
+          this->MergeSequentialTestCounts(worker);
         }
-        k--;
-        exactEstimateData.push_back(&(caller->data[k]));
-        notChosen[k] = false;
-        maxIndex--;
       }
-      // get the indexes of the chosen objects so we can check that
-      // this sub-set hasn't been chosen already
-      for (l = 0, m = 0; m < numDataObjects; m++)
+      this->RefreshSequentialTest(worker);
+    }
+    // found a better scoring model? Below the shared best score it cannot be
+    // the result, whatever the best of this thread, and its score may stop
+    // short of the full one
+    if (rejected || scoreForCur < this->bestScore ||
+        !IsBetterModel(
+          scoreForCur, residual, curHypothesis, worker.bestScore, worker.bestResidual, worker.bestHypothesis))
+      continue;
+
+    worker.bestNumVotes = numVotesForCur;
+    worker.bestScore = scoreForCur;
+    worker.bestResidual = residual;
+    worker.bestHypothesis = curHypothesis;
+    worker.bestParameters = worker.exactEstimateParameters;
+    worker.bestInliers.clear();
+    for (m = 0; m < worker.numberOfTested; m++)
+    {
+      if (result[m] >= 0.0)
+        worker.bestInliers.push_back(useSPRT ? this->agreeDataOrder[m] : m);
+    }
+    if (useSPRT)
+      std::sort(worker.bestInliers.begin(), worker.bestInliers.end());
+
+    // the lock is only taken for a model that may be the best of all
+    bool best = false;
+    {
+      std::lock_guard<std::mutex> lock(this->resultsMutex);
+      if (IsBetterModel(
+            scoreForCur, residual, curHypothesis, this->bestScore, this->bestResidual, this->bestHypothesis))
       {
-        if (!notChosen[m])
+        this->numVotesForBest = numVotesForCur;
+        this->bestScore = scoreForCur;
+        this->bestResidual = residual;
+        this->bestHypothesis = curHypothesis;
+        if (useSPRT)
         {
-          curSubSetIndexes[l] = m + 1;
-          l++;
+          this->MergeSequentialTestCounts(worker);
+          this->sprt.UpdateInlierRatio((double)numVotesForCur / (double)numAgreeObjects);
+          this->PublishSequentialTest();
         }
+        this->UpdateNumberOfTries(numVotesForCur, numAgreeObjects, numForEstimate);
+        best = true;
       }
+    }
+    improved = best && numVotesForCur > 0;
+    if (best && this->samplingStrategy == SamplingStrategy::PROSAC)
+    {
+      if (useSPRT)
+        this->RefreshSequentialTest(worker);
+      this->UpdateProgressiveNumberOfTries(worker.exactEstimateParameters,
+                                           useSPRT ? worker.localTest.GetProbabilityOfAcceptance() : 1.0,
+                                           worker.progressiveAgreement);
+    }
 
-      caller->hypothesisMutex.lock();
-      // check that the sub-set just chosen is unique
-      std::pair<typename std::set<int *, SubSetIndexComparator>::iterator, bool> res =
-         caller->chosenSubSets->insert(curSubSetIndexes);
-      caller->hypothesisMutex.unlock();
-
-      if (res.second == true)
-      { // first time we chose this sub set
-        // use the selected data for an exact model parameter fit
-        caller->paramEstimator->Estimate(exactEstimateData, exactEstimateParameters);
-        // selected data is a singular configuration (e.g. three
-        // colinear points for a circle fit)
-        if (exactEstimateParameters.size() == 0)
-          continue;
-
-        // Inexpensive Test
-        if (caller->checkCorresspondenceDistanceFlag == true)
-        {
-          auto distanceFlag = caller->paramEstimator->CheckCorresspondenceDistance(exactEstimateParameters, exactEstimateData);
-          if (distanceFlag == false)
-          {
-            continue;
-          }
-        }
+    // a new best model, refine it without blocking the other threads
+    if (useLO && improved)
+    {
+      worker.inlierData.clear();
+      for (m = 0; m < worker.numberOfTested; m++)
+      {
+        if (result[m] >= 0.0)
+          worker.inlierData.push_back(
+            this->MakeInlierObject(useSPRT ? this->agreeDataOrder[m] : m, worker.correspondences[m]));
+      }
+      this->LocalOptimization(worker, numVotesForCur, scoreForCur, residual, curHypothesis);
+    }
+  }
+  return i - iterationBegin;
+}
 
-        // Inexpensive Test
-        if (caller->checkCorrespondenceEdgeLengthTest > 0)
-        {
-          auto edgeFlag = caller->paramEstimator->CheckCorresspondenceEdgeLength(exactEstimateParameters, exactEstimateData, caller->checkCorrespondenceEdgeLengthTest);
-          if (edgeFlag == false)
-          {
-            continue;
-          }
-        }
+/*****************************************************************************/
 
-        // see how many agree on this estimate
-        numVotesForCur = 0;
-        std::fill(curVotes, curVotes + numAgreeObjects, false);
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::GenerateHypothesis(size_t                              iteration,
+                                                 CounterBasedRandomNumberGenerator & randomGenerator,
+                                                 SubSetSampler &                     subSetSampler,
+                                                 unsigned int *                      subSetIndexes,
+                                                 std::vector<T *> &                  estimateData,
+                                                 std::vector<SType> &                parameters)
+{
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
 
-        // Expensive Inlier Test
-        auto result = caller->paramEstimator->AgreeMultiple(exactEstimateParameters, caller->agreeData, caller->numVotesForBest);
-        double rmse_value = 0.0;
+  // randomly select data for exact model fit ('numForEstimate' objects),
+  // the indexes are sorted so they also identify the sub-set
+  if (!this->DrawSubSet(iteration, randomGenerator, subSetSampler, subSetIndexes))
+    return false;
+  for (unsigned int l = 0; l < numForEstimate; l++)
+  {
+    estimateData[l] = &(this->data[subSetIndexes[l]]);
+  }
 
-        for (m = 0; m < numAgreeObjects; m++)
-        {
-          if (result[m] > 0)
-          {
-            curVotes[m] = true;
-            numVotesForCur++;
-            rmse_value = rmse_value + result[m];
-          }
-        } // found a larger consensus set?
-
-        caller->resultsMutex.lock();
-        if (numVotesForCur > caller->numVotesForBest || (numVotesForCur == caller->numVotesForBest && rmse_value < caller->bestRMSE))
-        {
-          caller->numVotesForBest = numVotesForCur;
-          caller->bestRMSE = rmse_value;
+  // check that the sub-set just chosen is unique, enumerated ones are
+  if (!this->enumerating && !this->chosenSubSets.Insert(subSetIndexes))
+    return false;
 
-          std::copy(curVotes, curVotes + numAgreeObjects, caller->bestVotes);
+  // skip configurations too close to degenerate before solving for them
+  if (this->degeneracyThreshold > 0.0 &&
+      !this->paramEstimator->CheckSubSetConditioning(estimateData, this->degeneracyThreshold))
+  {
+    this->numberOfDegenerateSubSets.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // use the selected data for an exact model parameter fit
+  this->paramEstimator->Estimate(estimateData, parameters);
+  // selected data is a singular configuration (e.g. three
+  // colinear points for a circle fit)
+  if (parameters.size() == 0)
+    return false;
+
+  // Inexpensive Test
+  if (this->checkCorresspondenceDistanceFlag == true)
+  {
+    auto distanceFlag = this->paramEstimator->CheckCorresspondenceDistance(parameters, estimateData);
+    if (distanceFlag == false)
+    {
+      return false;
+    }
+  }
 
-          caller->parametersRansac.clear();
-          for (unsigned int kp=0; kp < exactEstimateParameters.size(); ++kp)
-          {
-            caller->parametersRansac.push_back(exactEstimateParameters[kp]);
-          }
+  // Inexpensive Test, compatible subsets pass it by construction
+  if (this->checkCorrespondenceEdgeLengthTest > 0 &&
+      (this->samplingStrategy != SamplingStrategy::Compatible || this->enumerating))
+  {
+    auto edgeFlag = this->paramEstimator->CheckCorresspondenceEdgeLength(parameters, estimateData, this->checkCorrespondenceEdgeLengthTest);
+    if (edgeFlag == false)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::ComputePreemptive(itk::MultiThreaderBase * threader)
+{
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+  const unsigned int numAgreeObjects = this->agreeData.size();
+  const size_t       numHypotheses = std::min((size_t)this->maxIteration, (size_t)this->allTries);
+
+  // generate the whole batch of hypotheses, hypothesis i uses random stream
+  // i as with a global iteration budget
+  std::vector<std::vector<SType>> hypotheses(numHypotheses);
+  std::vector<char>               valid(numHypotheses, 0);
+  threader->ParallelizeArray(
+    0,
+    numHypotheses,
+    [this, &hypotheses, &valid, numForEstimate](SizeValueType i) {
+      SubSetSampler subSetSampler;
+      subSetSampler.Initialize(numForEstimate);
+      CounterBasedRandomNumberGenerator randomGenerator;
+      randomGenerator.reset(this->randomSeed, i);
+      std::vector<unsigned int> subSetIndexes(numForEstimate);
+      std::vector<T *>          estimateData(numForEstimate);
+      valid[i] = this->GenerateHypothesis(
+        i, randomGenerator, subSetSampler, subSetIndexes.data(), estimateData, hypotheses[i]);
+    },
+    nullptr);
+  this->numberOfIterations = numHypotheses;
+
+  struct PreemptiveScore
+  {
+    size_t hypothesis;
+    double score;
+    double residual;
+  };
+  // larger score first, then the smaller residual, then the first hypothesis
+  auto better = [](const PreemptiveScore & a, const PreemptiveScore & b) {
+    if (a.score != b.score)
+      return a.score > b.score;
+    if (a.residual != b.residual)
+      return a.residual < b.residual;
+    return a.hypothesis < b.hypothesis;
+  };
+
+  std::vector<PreemptiveScore> remaining;
+  for (size_t i = 0; i < numHypotheses; ++i)
+  {
+    if (valid[i])
+      remaining.push_back({ i, 0, 0.0 });
+  }
+  if (remaining.empty())
+    return;
+
+  // score the remaining hypotheses on the next block of the shuffled agree
+  // data, then keep the best fraction of them
+  for (unsigned int blockBegin = 0; blockBegin < numAgreeObjects && remaining.size() > 1;
+       blockBegin += this->preemptionBlockSize)
+  {
+    const unsigned int blockEnd = std::min(blockBegin + this->preemptionBlockSize, numAgreeObjects);
+    threader->ParallelizeArray(
+      0,
+      remaining.size(),
+      [this, &hypotheses, &remaining, blockBegin, blockEnd](SizeValueType k) {
+        remaining[k].score += this->paramEstimator->AgreeBlock(
+          hypotheses[remaining[k].hypothesis], this->shuffledAgreeData, blockBegin, blockEnd, remaining[k].residual);
+      },
+      nullptr);
+    this->numberOfVerifiedObjects += remaining.size() * (blockEnd - blockBegin);
+
+    size_t retained = std::max((size_t)1, (size_t)(remaining.size() * this->preemptionRetainedFraction));
+    std::nth_element(remaining.begin(), remaining.begin() + (retained - 1), remaining.end(), better);
+    remaining.resize(retained);
+  }
+  const PreemptiveScore & winner = *std::min_element(remaining.begin(), remaining.end(), better);
+
+  // the votes of the winner on all the agree data, as the other modes report
+  this->SetBestModel(hypotheses[winner.hypothesis], winner.hypothesis);
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SetBestModel(const std::vector<SType> & parameters, uint64_t hypothesis)
+{
+  const unsigned int             numAgreeObjects = this->agreeData.size();
+  std::vector<SType>             modelParameters = parameters;
+  SequentialProbabilityRatioTest fullTest;
+  bool                           rejected;
+  unsigned int                   numberOfTested;
+  double                         score;
+  std::vector<double>            result = this->paramEstimator->AgreeMultipleSequential(
+    modelParameters, this->agreeData, 0.0, fullTest, rejected, numberOfTested, score);
+  this->bestInliers.clear();
+  this->numVotesForBest = 0;
+  this->bestScore = score;
+  this->bestResidual = 0.0;
+  for (unsigned int m = 0; m < numAgreeObjects; m++)
+  {
+    if (result[m] >= 0.0)
+    {
+      this->bestInliers.push_back(m);
+      this->numVotesForBest++;
+      this->bestResidual += result[m];
+    }
+  }
+  this->bestHypothesis = hypothesis;
+  this->parametersRansac = modelParameters;
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::ApplyCompatibilityPrefilter(itk::MultiThreaderBase * threader,
+                                                          std::vector<T> &         allData,
+                                                          std::vector<double> &    allDataQuality)
+{
+  CompatibilityGraph graph;
+  graph.Build(this->data[0].GetDataPointer(),
+              T::PointDimension,
+              this->data.size(),
+              this->checkCorrespondenceEdgeLengthTest,
+              threader);
+  const std::vector<uint32_t> clique = graph.FindLargeClique();
+  this->compatibleSetSize = clique.size();
+  if (clique.size() < this->paramEstimator->GetMinimalForEstimate())
+    return false;
+
+  std::vector<T>      cliqueData;
+  std::vector<double> cliqueDataQuality;
+  cliqueData.reserve(clique.size());
+  for (uint32_t i : clique)
+  {
+    cliqueData.push_back(this->data[i]);
+    if (!this->dataQuality.empty())
+      cliqueDataQuality.push_back(this->dataQuality[i]);
+  }
+  allData.swap(this->data);
+  allDataQuality.swap(this->dataQuality);
+  this->data.swap(cliqueData);
+  this->dataQuality.swap(cliqueDataQuality);
+  return true;
+}
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::InitializeSampling(itk::MultiThreaderBase * threader)
+{
+  this->rank.clear();
+  this->progressiveGrowth.clear();
+  this->progressiveMinimumInliers.clear();
+  this->neighbors.clear();
+  this->neighborsPerObject = 0;
+  this->compatibleSets.clear();
+  this->compatibleSetWords = 0;
+  this->compatibleSeeds.clear();
+
+  const size_t       numDataObjects = this->data.size();
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  if (this->samplingStrategy == SamplingStrategy::Compatible)
+  {
+    if (!(this->checkCorrespondenceEdgeLengthTest > 0))
+      throw ExceptionObject(__FILE__, __LINE__, "Compatible sampling needs the edge length ratio.");
+
+    CompatibilityGraph graph;
+    graph.Build(this->data[0].GetDataPointer(),
+                T::PointDimension,
+                numDataObjects,
+                this->checkCorrespondenceEdgeLengthTest,
+                threader);
+    this->compatibleSetWords = (numDataObjects + 63) / 64;
+    this->compatibleSets.assign(numDataObjects * this->compatibleSetWords, 0);
+    for (size_t i = 0; i < numDataObjects; ++i)
+    {
+      uint64_t *       objectSet = &this->compatibleSets[i * this->compatibleSetWords];
+      const uint32_t * objectNeighbors = graph.GetNeighbors(i);
+      for (size_t k = 0; k < graph.GetDegree(i); ++k)
+        objectSet[objectNeighbors[k] / 64] |= uint64_t(1) << (objectNeighbors[k] % 64);
+      if (graph.GetDegree(i) + 1 >= numForEstimate)
+        this->compatibleSeeds.push_back(i);
+    }
+    return;
+  }
+
+  if (this->samplingStrategy == SamplingStrategy::NAPSAC)
+  {
+    if (this->neighborhoodSize + 1 < numForEstimate)
+      throw ExceptionObject(__FILE__, __LINE__, "The NAPSAC neighborhood is smaller than the minimal subset.");
+
+    // nearest neighbours of every fixed point, the query returns the point
+    // itself too, unless it has more than neighborsPerObject duplicates
+    KDTreeFlatArrayAdaptor<double, 3, uint32_t> tree;
+    tree.SetPoints(this->data[0].GetDataPointer(), T::PointDimension, numDataObjects);
+    this->neighborsPerObject = std::min<size_t>(this->neighborhoodSize, numDataObjects - 1);
+    this->neighbors.resize(numDataObjects * this->neighborsPerObject);
+    std::vector<uint32_t> indexes(this->neighborsPerObject + 1);
+    std::vector<double>   distances(this->neighborsPerObject + 1);
+    for (size_t i = 0; i < numDataObjects; ++i)
+    {
+      size_t found = tree.GetIndex()->knnSearch(tree.GetPoint(i), this->neighborsPerObject + 1, indexes.data(), distances.data());
+      unsigned int * objectNeighbors = &this->neighbors[i * this->neighborsPerObject];
+      unsigned int   count = 0;
+      for (size_t j = 0; j < found && count < this->neighborsPerObject; ++j)
+      {
+        if (indexes[j] != i)
+          objectNeighbors[count++] = indexes[j];
+      }
+    }
+    return;
+  }
+  if (this->samplingStrategy != SamplingStrategy::PROSAC)
+    return;
+
+  // rank the data best first, without quality values the data are taken to
+  // be sorted already
+  this->rank.resize(numDataObjects);
+  for (size_t i = 0; i < numDataObjects; ++i)
+    this->rank[i] = i;
+  if (!this->dataQuality.empty())
+  {
+    std::stable_sort(this->rank.begin(), this->rank.end(), [this](unsigned int a, unsigned int b) {
+      return this->dataQuality[a] > this->dataQuality[b];
+    });
+  }
+
+  // growth schedule: T_n is the expected number of samples drawn from the
+  // best n objects among ProgressiveSamplingMaxSamples uniform samples,
+  // T_{n+1} = T_n (n+1)/(n+1-m), and T'_{n+1} = T'_n + ceil(T_{n+1} - T_n)
+  this->progressiveGrowth.assign(numDataObjects + 1, 0);
+  double Tn = ProgressiveSamplingMaxSamples;
+  for (unsigned int i = 0; i < numForEstimate; ++i)
+    Tn *= (double)(numForEstimate - i) / (double)(numDataObjects - i);
+  this->progressiveGrowth[numForEstimate] = 1;
+  for (size_t n = numForEstimate; n < numDataObjects; ++n)
+  {
+    double nextTn = Tn * (double)(n + 1) / (double)(n + 1 - numForEstimate);
+    this->progressiveGrowth[n + 1] = this->progressiveGrowth[n] + (size_t)ceil(nextTn - Tn);
+    Tn = nextTn;
+  }
+
+  // non-randomness: the least number of inliers among the best n objects
+  // that a wrong model supports with probability below 5%, the binomial
+  // tail is approximated as in the paper by a normal one
+  this->progressiveMinimumInliers.assign(numDataObjects + 1, 0);
+  for (size_t n = numForEstimate; n <= numDataObjects; ++n)
+  {
+    double mean = (n - numForEstimate) * ProgressiveSamplingBadModelInlierRatio;
+    double sigma = sqrt(mean * (1.0 - ProgressiveSamplingBadModelInlierRatio));
+    this->progressiveMinimumInliers[n] = numForEstimate + (unsigned int)ceil(mean + sigma * sqrt(2.706));
+  }
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::UpdateProgressiveNumberOfTries(std::vector<SType> & parameters,
+                                                             double               probabilityOfAcceptance,
+                                                             std::vector<char> &  agree)
+{
+  // an enumeration always covers all the subsets
+  if (this->enumerating)
+    return;
+
+  // one pass of the estimator over the data, without the lock
+  this->paramEstimator->AgreeEach(parameters, this->data, agree);
+
+  const size_t       numDataObjects = this->data.size();
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  // maximality: for every set of the best n objects with a non-random number
+  // of inliers I_n, log(1-p)/log(1-P_n) hypotheses drawn from it find an
+  // outlier free subset with probability p, P_n being the probability that a
+  // subset of the n objects is outlier free. The smallest bound is kept.
+  double       bestTries = std::numeric_limits<double>::max();
+  unsigned int inliers = 0;
+  for (size_t n = 1; n <= numDataObjects; ++n)
+  {
+    if (agree[this->rank[n - 1]])
+      inliers++;
+    if (n < numForEstimate || inliers < this->progressiveMinimumInliers[n])
+      continue;
+
+    double probability = 1.0;
+    for (unsigned int j = 0; j < numForEstimate; ++j)
+      probability *= (double)(inliers - j) / (double)(n - j);
+    probability *= probabilityOfAcceptance;
+    if (probability >= 1.0)
+    {
+      bestTries = 0.0;
+      break;
+    }
+    double denominator = log(1.0 - probability);
+    if (denominator < 0.0)
+      bestTries = std::min(bestTries, ceil(this->numerator / denominator));
+  }
+
+  std::lock_guard<std::mutex> lock(this->resultsMutex);
+  if (bestTries < (double)this->numTries)
+    this->numTries = (unsigned int)bestTries;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::UnrankSubSet(size_t subSetRank, unsigned int * indexes)
+{
+  const size_t       columns = this->data.size() + 1;
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  // greedily from the largest index down, c_k is the largest c with
+  // C(c, k) <= the remaining rank, and c_k < c_(k+1)
+  size_t c = this->data.size();
+  for (unsigned int k = numForEstimate; k > 0; --k)
+  {
+    const uint64_t * row = &this->binomials[k * columns];
+    do
+    {
+      --c;
+    } while (row[c] > subSetRank);
+    indexes[k - 1] = c;
+    subSetRank -= row[c];
+  }
+}
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::DrawSubSet(size_t                              iteration,
+                                         CounterBasedRandomNumberGenerator & randomGenerator,
+                                         SubSetSampler &                     subSetSampler,
+                                         unsigned int *                      indexes)
+{
+  const unsigned int numDataObjects = this->data.size();
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  if (this->enumerating)
+  {
+    this->UnrankSubSet(iteration, indexes);
+    return true;
+  }
+
+  if (this->samplingStrategy == SamplingStrategy::PROSAC)
+  {
+    // the hypothesis number counted from one selects the stage n, the first
+    // with progressiveGrowth[n] >= t
+    const size_t t = iteration + 1;
+    auto         stage = std::lower_bound(this->progressiveGrowth.begin() + numForEstimate, this->progressiveGrowth.end(), t);
+    if (stage != this->progressiveGrowth.end())
+    {
+      // the n'th best object and m-1 of the n-1 better ones
+      unsigned int n = stage - this->progressiveGrowth.begin();
+      subSetSampler.Sample(randomGenerator, n - 1, numForEstimate - 1, indexes);
+      indexes[numForEstimate - 1] = n - 1;
+    }
+    else
+    {
+      // past the schedule, uniform over all the data
+      subSetSampler.Sample(randomGenerator, numDataObjects, numForEstimate, indexes);
+    }
+    for (unsigned int l = 0; l < numForEstimate; ++l)
+      indexes[l] = this->rank[indexes[l]];
+    std::sort(indexes, indexes + numForEstimate);
+    return true;
+  }
+
+  if (this->samplingStrategy == SamplingStrategy::NAPSAC)
+  {
+    // a uniform seed and m-1 of its neighbours
+    const unsigned int   seed = randomGenerator.uniformInteger(numDataObjects);
+    const unsigned int * objectNeighbors = &this->neighbors[(size_t)seed * this->neighborsPerObject];
+    subSetSampler.Sample(randomGenerator, this->neighborsPerObject, numForEstimate - 1, indexes);
+    for (unsigned int l = 0; l + 1 < numForEstimate; ++l)
+      indexes[l] = objectNeighbors[indexes[l]];
+    indexes[numForEstimate - 1] = seed;
+    std::sort(indexes, indexes + numForEstimate);
+    return true;
+  }
+
+  if (this->samplingStrategy == SamplingStrategy::Compatible)
+  {
+    if (this->compatibleSeeds.empty())
+      return false;
+    return subSetSampler.SampleCompatible(randomGenerator,
+                                          this->compatibleSets.data(),
+                                          this->compatibleSetWords,
+                                          this->compatibleSeeds.data(),
+                                          this->compatibleSeeds.size(),
+                                          numForEstimate,
+                                          indexes);
+  }
+
+  subSetSampler.SampleSorted(randomGenerator, numDataObjects, numForEstimate, indexes);
+  return true;
+}
+
+
+/*****************************************************************************/
+
+template <typename T,  typename SType, typename TTransform>
+T
+RANSAC<T, SType, TTransform>::MakeInlierObject(unsigned int index, unsigned int correspondence)
+{
+  T object = this->agreeData[index];
+  if (correspondence != ParametersEstimatorType::NoCorrespondence)
+  {
+    // fixed point of the agree object, moving point it was matched to
+    for (unsigned int k = 3; k < 6; ++k)
+      object[k] = this->agreeData[correspondence][k];
+  }
+  return object;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::SigmaConsensusEstimate(std::vector<SType> & parameters)
+{
+  const unsigned int        numAgreeObjects = this->agreeData.size();
+  const InlierScoringPolicy scoring = this->paramEstimator->GetScoringPolicy();
+  // a test that never rejects, every model is checked against all the data
+  SequentialProbabilityRatioTest fullTest;
+  bool                           rejected;
+  unsigned int                   numberOfTested;
+  std::vector<unsigned int>      correspondences;
+  std::vector<T>                 inliers;
+  std::vector<double>            weights;
+  std::vector<SType>             current = parameters;
+  double                         bestScore = -1.0;
+
+  for (unsigned int iteration = 0; iteration < SigmaConsensusIterations && !current.empty(); ++iteration)
+  {
+    double score;
+    auto   result = this->paramEstimator->AgreeMultipleSequential(
+      current, this->agreeData, 0.0, fullTest, rejected, numberOfTested, score, &correspondences);
+    if (score <= bestScore)
+      break;
+    bestScore = score;
+    parameters = current;
+
+    inliers.clear();
+    weights.clear();
+    for (unsigned int m = 0; m < numAgreeObjects; ++m)
+    {
+      if (result[m] >= 0.0)
+      {
+        inliers.push_back(this->MakeInlierObject(m, correspondences[m]));
+        weights.push_back(scoring.Weight(result[m]));
+      }
+    }
+    if (inliers.size() < this->paramEstimator->GetMinimalForEstimate())
+      break;
+    this->paramEstimator->WeightedLeastSquaresEstimate(inliers, weights, current);
+  }
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::LocalOptimization(HypothesisWorker & worker,
+                                                unsigned int       numVotes,
+                                                double             score,
+                                                double             residual,
+                                                uint64_t           hypothesis)
+{
+  const unsigned int numAgreeObjects = this->agreeData.size();
+  const unsigned int numForEstimate = this->paramEstimator->GetMinimalForEstimate();
+
+  // best model of this local optimization, it has to beat the model found by
+  // the hypothesis
+  std::vector<SType>        loParameters;
+  std::vector<SType>        parameters;
+  std::vector<unsigned int> loInlierIndexes;
+  unsigned int              loNumVotes = numVotes;
+  double                    loScore = score;
+  double                    loResidual = residual;
+  std::vector<T>            loInliers = worker.inlierData;
+  std::vector<T>            estimateData;
+  std::vector<unsigned int> correspondences;
+  // a test that never rejects, every model is checked against all the data
+  SequentialProbabilityRatioTest fullTest;
+  bool                           rejected;
+  unsigned int                   numberOfTested;
+
+  // least squares fit to fitData, then refit to the inliers of the fit as
+  // long as the score grows
+  auto iteratedLeastSquares = [&](std::vector<T> & fitData) {
+    for (unsigned int iteration = 0; iteration < LocalOptimizationLeastSquaresIterations; ++iteration)
+    {
+      this->paramEstimator->LeastSquaresEstimate(fitData, parameters);
+      if (parameters.empty())
+        return;
+
+      double curScore;
+      auto   result = this->paramEstimator->AgreeMultipleSequential(
+        parameters, this->agreeData, loScore, fullTest, rejected, numberOfTested, curScore, &correspondences);
+      unsigned int curNumVotes = 0;
+      double       curResidual = 0.0;
+      for (unsigned int m = 0; m < numAgreeObjects; ++m)
+      {
+        if (result[m] >= 0.0)
+        {
+          curNumVotes++;
+          curResidual += result[m];
         }
-        caller->resultsMutex.unlock();
       }
-      else
+      if (curScore < loScore || (curScore == loScore && curResidual >= loResidual))
+        return;
+
+      loNumVotes = curNumVotes;
+      loScore = curScore;
+      loResidual = curResidual;
+      loParameters = parameters;
+      loInlierIndexes.clear();
+      loInliers.clear();
+      for (unsigned int m = 0; m < numAgreeObjects; ++m)
       {
-        // this sub set already appeared, release memory
-        delete[] curSubSetIndexes;
+        if (result[m] >= 0.0)
+        {
+          loInlierIndexes.push_back(m);
+          loInliers.push_back(this->MakeInlierObject(m, correspondences[m]));
+        }
       }
+      fitData = loInliers;
     }
-    delete[] curVotes;
-    delete[] notChosen;
+  };
+
+  // iterated least squares on all the inliers of the hypothesis
+  estimateData = worker.inlierData;
+  iteratedLeastSquares(estimateData);
+
+  // inner RANSAC, least squares fits to random subsets of the current best
+  // inliers, each followed by iterated least squares
+  SubSetSampler                     sampler;
+  CounterBasedRandomNumberGenerator randomGenerator;
+  std::vector<unsigned int>         sampleIndexes;
+  randomGenerator.reset(this->randomSeed, hypothesis | (static_cast<uint64_t>(1) << 63));
+  for (unsigned int r = 0; r < this->numberOfLocalOptimizationIterations; ++r)
+  {
+    unsigned int sampleSize = std::min<size_t>(loInliers.size() / 2, LocalOptimizationSampleFactor * numForEstimate);
+    if (sampleSize <= numForEstimate)
+      break;
+
+    sampler.Initialize(sampleSize);
+    sampleIndexes.resize(sampleSize);
+    sampler.Sample(randomGenerator, loInliers.size(), sampleSize, sampleIndexes.data());
+    estimateData.clear();
+    for (unsigned int l = 0; l < sampleSize; ++l)
+      estimateData.push_back(loInliers[sampleIndexes[l]]);
+    iteratedLeastSquares(estimateData);
+  }
+
+  // the refined model beats the hypothesis, the best of this thread, publish
+  // its score if it is still better than the shared best
+  if (!loParameters.empty())
+  {
+    worker.bestNumVotes = loNumVotes;
+    worker.bestScore = loScore;
+    worker.bestResidual = loResidual;
+    worker.bestParameters = loParameters;
+    worker.bestInliers.swap(loInlierIndexes);
+  }
+  bool best = false;
+  {
+    std::lock_guard<std::mutex> lock(this->resultsMutex);
+    this->numberOfLocalOptimizations++;
+    if (loParameters.empty())
+      return;
+    if (IsBetterModel(loScore, loResidual, hypothesis, this->bestScore, this->bestResidual, this->bestHypothesis))
+    {
+      this->numVotesForBest = loNumVotes;
+      this->bestScore = loScore;
+      this->bestResidual = loResidual;
+      this->bestHypothesis = hypothesis;
+      if (this->useSequentialProbabilityRatioTest)
+      {
+        this->sprt.UpdateInlierRatio((double)loNumVotes / (double)numAgreeObjects);
+        this->PublishSequentialTest();
+      }
+      this->UpdateNumberOfTries(loNumVotes, numAgreeObjects, numForEstimate);
+      best = true;
+    }
+  }
+  if (best && this->samplingStrategy == SamplingStrategy::PROSAC)
+  {
+    if (this->useSequentialProbabilityRatioTest)
+      this->RefreshSequentialTest(worker);
+    this->UpdateProgressiveNumberOfTries(
+      loParameters,
+      this->useSequentialProbabilityRatioTest ? worker.localTest.GetProbabilityOfAcceptance() : 1.0,
+      worker.progressiveAgreement);
   }
-  return ITK_THREAD_RETURN_DEFAULT_VALUE;
 }
 
-/*****************************************************************************/
+
+template <typename T,  typename SType, typename TTransform>
+bool
+RANSAC<T, SType, TTransform>::ClaimIterations(size_t &       localIterations,
+                                              unsigned int & iterationBegin,
+                                              unsigned int & iterationEnd)
+{
+  // an enumeration covers all the subsets, shared by the threads
+  size_t limit = this->enumerating ? this->allTries : std::min(this->maxIteration, this->numTries.load());
+  size_t begin;
+  size_t end;
+  if (this->useGlobalIterationBudget || this->enumerating)
+  {
+    // all threads draw from the same budget, one chunk at a time
+    begin = this->nextIteration.fetch_add(this->iterationChunkSize);
+    end = begin + this->iterationChunkSize;
+  }
+  else
+  {
+    // every thread has a budget of its own, claim it all at once
+    begin = localIterations;
+    end = limit;
+  }
+  if (begin >= limit)
+    return false;
+
+  end = std::min(end, limit);
+  localIterations = end;
+  iterationBegin = static_cast<unsigned int>(begin);
+  iterationEnd = static_cast<unsigned int>(end);
+  return true;
+}
+
+
+template <typename T,  typename SType, typename TTransform>
+void
+RANSAC<T, SType, TTransform>::UpdateNumberOfTries(unsigned int inputNumVotesForBest,
+                                                  unsigned int numAgreeObjects,
+                                                  unsigned int numForEstimate)
+{
+  // an enumeration always covers all the subsets
+  if (this->enumerating)
+    return;
+
+  // all the agree data supports the model, no point in looking any further
+  if (inputNumVotesForBest >= numAgreeObjects)
+  {
+    this->numTries = 0;
+    return;
+  }
+
+  // probability that a minimal subset contains only inliers, estimated from
+  // the fraction of the agree data supporting the best model
+  double probability = pow((double)inputNumVotesForBest / (double)numAgreeObjects, (double)numForEstimate);
+  // a good hypothesis only counts if the sequential test accepts it
+  if (this->useSequentialProbabilityRatioTest)
+    probability *= this->sprt.GetProbabilityOfAcceptance();
+  double denominator = log(1.0 - probability);
+  // inlier ratio too small for the bound to be representable, keep the
+  // current number of tries
+  if (denominator >= 0.0)
+    return;
+
+  double newTries = ceil(this->numerator / denominator);
+  if (newTries < (double)this->numTries)
+    this->numTries = (unsigned int)newTries;
+}
+
 
 template <typename T,  typename SType, typename TTransform>
 unsigned int
@@ -0,0 +1,198 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkSequentialProbabilityRatioTest_h
+#define itkSequentialProbabilityRatioTest_h
+
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+namespace itk
+{
+
+/** \class SequentialProbabilityRatioTest
+ *
+ * \brief Wald's sequential probability ratio test for RANSAC hypotheses.
+ *
+ * The data objects are checked one at a time in random order. After each
+ * one the likelihood ratio lambda of "the model is bad" versus "the model is
+ * good" is multiplied by delta/epsilon if the object is consistent with the
+ * model and by (1-delta)/(1-epsilon) otherwise, where epsilon is the
+ * fraction of inliers of a good model and delta the fraction of objects
+ * consistent with a bad one. The model is rejected as soon as lambda exceeds
+ * the decision threshold A. A is the optimum of Chum and Matas, it balances
+ * the time spent verifying against the time spent drawing additional
+ * hypotheses to make up for good models rejected by mistake, which happens
+ * with probability at most 1/A.
+ *
+ * epsilon and delta are estimated online: epsilon is the inlier ratio of the
+ * best model found so far and delta the fraction of consistent objects
+ * observed while verifying the rejected models. A is recomputed whenever
+ * either changes.
+ *
+ * Chum O., Matas J., "Optimal Randomized RANSAC", IEEE PAMI 30(8), 2008.
+ *
+ *  \ingroup Ransac
+ */
+class SequentialProbabilityRatioTest
+{
+public:
+  /**
+   * Start a new test.
+   * @param inlierRatio Initial epsilon, a lower bound of the inlier ratio.
+   * @param badModelInlierRatio Initial delta.
+   * @param timeRatio Time needed to compute a hypothesis in units of the time
+   *                  needed to check one data object against it.
+   */
+  void
+  Initialize(double inlierRatio, double badModelInlierRatio, double timeRatio)
+  {
+    this->epsilon = inlierRatio;
+    this->delta = badModelInlierRatio;
+    this->hypothesisTime = timeRatio;
+    this->numberOfConsistent = 0.0;
+    this->numberOfTested = 0.0;
+    this->Update();
+  }
+
+  /** Raise epsilon to the inlier ratio of a new best model. */
+  void
+  UpdateInlierRatio(double inlierRatio)
+  {
+    if (inlierRatio > this->epsilon)
+    {
+      this->epsilon = inlierRatio;
+      this->Update();
+    }
+  }
+
+  /**
+   * Record the objects checked while verifying rejected models, the counts
+   * may be summed over several models. delta is replaced by the pooled
+   * estimate once that differs from it by more than 10 percent.
+   */
+  void
+  AddRejectedModel(unsigned int consistent, unsigned int tested)
+  {
+    this->numberOfConsistent += consistent;
+    this->numberOfTested += tested;
+    double estimate = std::max(this->numberOfConsistent / this->numberOfTested, MinimumRatio);
+    if (fabs(estimate - this->delta) > 0.1 * this->delta)
+    {
+      this->delta = estimate;
+      this->Update();
+    }
+  }
+
+  /** True if the test can reject models, i.e. epsilon is larger than delta. */
+  bool
+  IsActive() const
+  {
+    return this->active;
+  }
+
+  /** Factor applied to the likelihood ratio for a consistent object. */
+  double
+  GetConsistentFactor() const
+  {
+    return this->consistentFactor;
+  }
+
+  /** Factor applied to the likelihood ratio for an inconsistent object. */
+  double
+  GetInconsistentFactor() const
+  {
+    return this->inconsistentFactor;
+  }
+
+  /** The model is rejected once the likelihood ratio exceeds this. */
+  double
+  GetDecisionThreshold() const
+  {
+    return this->decisionThreshold;
+  }
+
+  /** Lower bound of the probability that a good model passes the test. */
+  double
+  GetProbabilityOfAcceptance() const
+  {
+    return this->active ? 1.0 - 1.0 / this->decisionThreshold : 1.0;
+  }
+
+  double
+  GetInlierRatio() const
+  {
+    return this->epsilon;
+  }
+
+  double
+  GetBadModelInlierRatio() const
+  {
+    return this->delta;
+  }
+
+private:
+  void
+  Update()
+  {
+    this->active = this->delta < this->epsilon && this->epsilon < 1.0;
+    if (!this->active)
+    {
+      this->consistentFactor = 1.0;
+      this->inconsistentFactor = 1.0;
+      this->decisionThreshold = std::numeric_limits<double>::infinity();
+      return;
+    }
+    this->consistentFactor = this->delta / this->epsilon;
+    this->inconsistentFactor = (1.0 - this->delta) / (1.0 - this->epsilon);
+
+    // expected log likelihood ratio per object of a bad model, A is the fixed
+    // point of A = hypothesisTime * C + 1 + log(A)
+    double C = (1.0 - this->delta) * log(this->inconsistentFactor) + this->delta * log(this->consistentFactor);
+    double K = this->hypothesisTime * C + 1.0;
+    double A = K;
+    for (unsigned int i = 0; i < 10; ++i)
+    {
+      double next = K + log(A);
+      if (fabs(next - A) < 1e-6 * A)
+      {
+        A = next;
+        break;
+      }
+      A = next;
+    }
+    this->decisionThreshold = A;
+  }
+
+  static constexpr double MinimumRatio = 1e-6;
+
+  double epsilon = 0.1;
+  double delta = 0.01;
+  double hypothesisTime = 200.0;
+  double numberOfConsistent = 0.0;
+  double numberOfTested = 0.0;
+  double consistentFactor = 1.0;
+  double inconsistentFactor = 1.0;
+  double decisionThreshold = std::numeric_limits<double>::infinity();
+  bool   active = false;
+};
+
+} // end namespace itk
+
+#endif
@@ -0,0 +1,288 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkSubSetFingerprintTable_h
+#define itkSubSetFingerprintTable_h
+
+#include <atomic>
+#include <stdint.h>
+#include <algorithm>
+
+namespace itk
+{
+
+/** \class SubSetFingerprintTable
+ *
+ * \brief Concurrent set of the minimal subsets already drawn by RANSAC.
+ *
+ * Every subset (a sorted list of indexes into the data) is reduced to a
+ * 64-bit fingerprint which is stored in lock-free open addressing hash
+ * tables, so any number of threads can insert without a mutex.
+ *
+ * Uniqueness guarantee:
+ * 1. If the indexes of a subset fit into 63 bits (e.g. three indexes into
+ *    less than 2^21 data objects) the fingerprint is an exact encoding of the
+ *    subset and a subset is reported as already drawn only if it really was.
+ * 2. Otherwise the fingerprint is a 64-bit hash. Two different subsets
+ *    collide with probability 2^-64, so after n insertions the probability of
+ *    wrongly skipping a new subset is below n^2/2^65. A collision only costs
+ *    one skipped hypothesis.
+ *
+ * The fingerprints are stored in levels, level l has FirstLevelCapacity *
+ * 2^l slots and takes new fingerprints until it is half full, then the next
+ * level is allocated. The memory therefore follows the number of subsets
+ * actually drawn, not the bound given to Initialize(), and an insert looks
+ * the fingerprint up in the full levels first. Once the levels can hold the
+ * bound (or MaximumNumberOfSubSets) and the last one is half full, new
+ * subsets are no longer recorded and Insert() reports every subset as new,
+ * i.e. memory stays bounded and duplicates are evaluated again. Two threads
+ * inserting the same subset while a level fills up may both see it as new,
+ * which also only costs one evaluation.
+ *
+ *  \ingroup Ransac
+ */
+class SubSetFingerprintTable
+{
+public:
+  SubSetFingerprintTable() = default;
+  SubSetFingerprintTable(const SubSetFingerprintTable &) = delete;
+  SubSetFingerprintTable &
+  operator=(const SubSetFingerprintTable &) = delete;
+
+  ~SubSetFingerprintTable()
+  {
+    this->ReleaseLevels(0);
+  }
+
+  /**
+   * Prepare the table for a new run, removing all previously inserted
+   * subsets. Only the first level is kept allocated.
+   * @param expectedNumberOfSubSets Upper bound on the number of subsets that
+   *                                will be inserted, more are not recorded.
+   * @param inputSubSetSize Number of indexes in each subset.
+   * @param numberOfObjects Number of data objects, all indexes are smaller.
+   */
+  void
+  Initialize(size_t expectedNumberOfSubSets, unsigned int inputSubSetSize, size_t numberOfObjects)
+  {
+    this->subSetSize = inputSubSetSize;
+
+    // indexes are stored shifted by one, so numberOfObjects must fit
+    this->bitsPerIndex = 1;
+    while (this->bitsPerIndex < 64 && (static_cast<uint64_t>(1) << this->bitsPerIndex) <= numberOfObjects)
+      this->bitsPerIndex++;
+    this->exact = static_cast<size_t>(this->bitsPerIndex) * this->subSetSize <= 63;
+
+    // the fewest levels that record the bound at a load factor of one half
+    const size_t bound = std::min(expectedNumberOfSubSets, MaximumNumberOfSubSets);
+    size_t       recorded = 0;
+    this->numberOfLevels = 0;
+    while (this->numberOfLevels < MaximumNumberOfLevels && (this->numberOfLevels == 0 || recorded < bound))
+    {
+      recorded += LevelCapacity(this->numberOfLevels) / 2;
+      this->numberOfLevels++;
+    }
+
+    this->ReleaseLevels(1);
+    std::atomic<uint64_t> * first = this->levels[0].load(std::memory_order_relaxed);
+    if (first == nullptr)
+    {
+      first = new std::atomic<uint64_t>[FirstLevelCapacity];
+      this->levels[0].store(first, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < FirstLevelCapacity; i++)
+      first[i].store(0, std::memory_order_relaxed);
+    for (unsigned int level = 0; level < MaximumNumberOfLevels; level++)
+      this->sizes[level].store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Insert a subset. Safe to call concurrently from multiple threads.
+   * @param sortedIndexes The subSetSize indexes of the subset in ascending
+   *                      order.
+   * @return true if the subset was not drawn before (or is no longer
+   *         recorded), false if it is a duplicate.
+   */
+  bool
+  Insert(const unsigned int * sortedIndexes)
+  {
+    const uint64_t fingerprint = this->Fingerprint(sortedIndexes);
+    for (unsigned int level = 0; level < this->numberOfLevels; level++)
+    {
+      std::atomic<uint64_t> * slots = this->levels[level].load(std::memory_order_acquire);
+      if (slots == nullptr)
+        slots = this->AllocateLevel(level);
+
+      const size_t capacity = LevelCapacity(level);
+      if (this->sizes[level].load(std::memory_order_relaxed) >= capacity / 2)
+      {
+        // a full level, the subset may have been recorded in it
+        if (Contains(slots, capacity, fingerprint))
+          return false;
+        continue;
+      }
+
+      const size_t mask = capacity - 1;
+      size_t       slot = Mix(fingerprint) & mask;
+      for (size_t probe = 0; probe < capacity; probe++)
+      {
+        uint64_t current = slots[slot].load(std::memory_order_relaxed);
+        if (current == fingerprint)
+          return false;
+        if (current == 0)
+        {
+          if (slots[slot].compare_exchange_strong(current, fingerprint, std::memory_order_relaxed))
+          {
+            this->sizes[level].fetch_add(1, std::memory_order_relaxed);
+            return true;
+          }
+          // another thread claimed the slot, it may have inserted the same subset
+          if (current == fingerprint)
+            return false;
+        }
+        slot = (slot + 1) & mask;
+      }
+    }
+    return true;
+  }
+
+  /** True if fingerprints are exact encodings of the subsets (no false
+   * positives), false if they are hashes. */
+  bool
+  IsExact() const
+  {
+    return this->exact;
+  }
+
+  /** Number of subsets recorded since the last Initialize(). */
+  size_t
+  GetNumberOfSubSets() const
+  {
+    size_t numberOfSubSets = 0;
+    for (unsigned int level = 0; level < MaximumNumberOfLevels; level++)
+      numberOfSubSets += this->sizes[level].load(std::memory_order_relaxed);
+    return numberOfSubSets;
+  }
+
+  /** Number of slots allocated, 8 bytes each. */
+  size_t
+  GetNumberOfSlots() const
+  {
+    size_t numberOfSlots = 0;
+    for (unsigned int level = 0; level < MaximumNumberOfLevels; level++)
+    {
+      if (this->levels[level].load(std::memory_order_relaxed) != nullptr)
+        numberOfSlots += LevelCapacity(level);
+    }
+    return numberOfSlots;
+  }
+
+  /** Upper bound on the number of subsets the levels are sized for, bounds
+   * the memory used by the table to about 4*MaximumNumberOfSubSets*8 bytes. */
+  static constexpr size_t MaximumNumberOfSubSets = static_cast<size_t>(1) << 22;
+
+private:
+  static constexpr size_t       FirstLevelCapacity = 1024;
+  static constexpr unsigned int MaximumNumberOfLevels = 14;
+
+  static size_t
+  LevelCapacity(unsigned int level)
+  {
+    return FirstLevelCapacity << level;
+  }
+
+  std::atomic<uint64_t> *
+  AllocateLevel(unsigned int level)
+  {
+    const size_t            capacity = LevelCapacity(level);
+    std::atomic<uint64_t> * slots = new std::atomic<uint64_t>[capacity];
+    for (size_t i = 0; i < capacity; i++)
+      slots[i].store(0, std::memory_order_relaxed);
+
+    // the first thread to get here publishes its level
+    std::atomic<uint64_t> * expected = nullptr;
+    if (!this->levels[level].compare_exchange_strong(expected, slots, std::memory_order_acq_rel))
+    {
+      delete[] slots;
+      return expected;
+    }
+    return slots;
+  }
+
+  void
+  ReleaseLevels(unsigned int firstLevel)
+  {
+    for (unsigned int level = firstLevel; level < MaximumNumberOfLevels; level++)
+      delete[] this->levels[level].exchange(nullptr, std::memory_order_relaxed);
+  }
+
+  static bool
+  Contains(const std::atomic<uint64_t> * slots, size_t capacity, uint64_t fingerprint)
+  {
+    const size_t mask = capacity - 1;
+    size_t       slot = Mix(fingerprint) & mask;
+    for (size_t probe = 0; probe < capacity; probe++)
+    {
+      uint64_t current = slots[slot].load(std::memory_order_relaxed);
+      if (current == fingerprint)
+        return true;
+      if (current == 0)
+        return false;
+      slot = (slot + 1) & mask;
+    }
+    return false;
+  }
+
+  uint64_t
+  Fingerprint(const unsigned int * sortedIndexes) const
+  {
+    uint64_t fingerprint = 0;
+    if (this->exact)
+    {
+      // indexes are shifted by one so that the fingerprint is never zero,
+      // zero marks an empty slot
+      for (unsigned int i = 0; i < this->subSetSize; i++)
+        fingerprint = (fingerprint << this->bitsPerIndex) | (static_cast<uint64_t>(sortedIndexes[i]) + 1);
+      return fingerprint;
+    }
+
+    for (unsigned int i = 0; i < this->subSetSize; i++)
+      fingerprint = Mix(fingerprint ^ (static_cast<uint64_t>(sortedIndexes[i]) + 0x9E3779B97F4A7C15ULL));
+    return fingerprint == 0 ? 1 : fingerprint;
+  }
+
+  /** splitmix64 finalizer */
+  static uint64_t
+  Mix(uint64_t x)
+  {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+  std::atomic<std::atomic<uint64_t> *> levels[MaximumNumberOfLevels] = {};
+  std::atomic<size_t>                  sizes[MaximumNumberOfLevels] = {};
+  unsigned int                         numberOfLevels = 0;
+  unsigned int                         subSetSize = 0;
+  unsigned int                         bitsPerIndex = 1;
+  bool                                 exact = true;
+};
+
+} // end namespace itk
+
+#endif
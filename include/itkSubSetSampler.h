@@ -0,0 +1,249 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkSubSetSampler_h
+#define itkSubSetSampler_h
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "RandomNumberGenerator.h"
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+namespace itk
+{
+
+/** \class SubSetSampler
+ *
+ * \brief Draws minimal subsets of distinct indexes for RANSAC.
+ *
+ * Subsets of k distinct indexes out of [0,n) are drawn with Floyd's
+ * algorithm, which needs exactly k random numbers and never touches an
+ * n-sized buffer. Membership of the indexes drawn so far is tested with a
+ * linear scan for small subsets and with a small hash table (O(1) expected)
+ * for large ones, so a subset costs O(k) expected time plus O(k log k) for
+ * sorting it. Each thread owns its sampler, memory is allocated only in
+ * Initialize() and by the first call to SampleCompatible().
+ *
+ *  \ingroup Ransac
+ */
+class SubSetSampler
+{
+public:
+  /**
+   * Allocate the scratch memory for subsets of up to maxSubSetSize indexes.
+   */
+  void
+  Initialize(unsigned int maxSubSetSize)
+  {
+    if (maxSubSetSize <= LinearScanSize)
+      return;
+    size_t tableSize = 16;
+    this->shift = 28;
+    while (tableSize < 2 * (size_t)maxSubSetSize)
+    {
+      tableSize *= 2;
+      this->shift--;
+    }
+    this->keys.assign(tableSize, 0);
+    this->stamps.assign(tableSize, 0);
+    this->stamp = 0;
+  }
+
+  /**
+   * Draw k distinct indexes uniformly from [0,n) in ascending order.
+   * @param randomGenerator Source of the random numbers.
+   * @param n Number of objects to choose from, k <= n.
+   * @param k Number of indexes to draw, at most the size given to Initialize.
+   * @param indexes Output array of k indexes.
+   */
+  void
+  SampleSorted(CounterBasedRandomNumberGenerator & randomGenerator, unsigned int n, unsigned int k, unsigned int * indexes)
+  {
+    this->Sample(randomGenerator, n, k, indexes);
+    std::sort(indexes, indexes + k);
+  }
+
+  /**
+   * Draw k distinct indexes uniformly from [0,n), in no particular order.
+   */
+  void
+  Sample(CounterBasedRandomNumberGenerator & randomGenerator, unsigned int n, unsigned int k, unsigned int * indexes)
+  {
+    // Floyd: for j = n-k..n-1 pick t in [0,j], if t was already chosen take j
+    // instead, which cannot have been chosen before
+    if (k <= LinearScanSize)
+    {
+      for (unsigned int l = 0, j = n - k; l < k; l++, j++)
+      {
+        unsigned int t = randomGenerator.uniformInteger(j + 1);
+        if (std::find(indexes, indexes + l, t) != indexes + l)
+          t = j;
+        indexes[l] = t;
+      }
+      return;
+    }
+
+    this->NextStamp();
+    for (unsigned int l = 0, j = n - k; l < k; l++, j++)
+    {
+      unsigned int t = randomGenerator.uniformInteger(j + 1);
+      if (!this->Insert(t))
+      {
+        t = j;
+        this->Insert(t);
+      }
+      indexes[l] = t;
+    }
+  }
+
+  /**
+   * Draw k distinct pairwise compatible indexes in ascending order: a seed
+   * uniformly from seeds, then one index at a time uniformly among the
+   * objects compatible with all the ones drawn so far. A draw that runs out
+   * of candidates starts over with a new seed, up to
+   * CompatibleSampleAttempts times.
+   * @param compatible Compatibility bitsets, bit j of the words [i * words,
+   *                   (i + 1) * words) is set if objects i and j are
+   *                   compatible. No object is compatible with itself.
+   * @param words Number of 64-bit words per object.
+   * @param seeds Objects to draw the seed from.
+   * @param numberOfSeeds Number of seeds, at least 1.
+   * @return false if no compatible subset was drawn.
+   */
+  bool
+  SampleCompatible(CounterBasedRandomNumberGenerator & randomGenerator,
+                   const uint64_t *                    compatible,
+                   size_t                              words,
+                   const unsigned int *                seeds,
+                   unsigned int                        numberOfSeeds,
+                   unsigned int                        k,
+                   unsigned int *                      indexes)
+  {
+    if (this->candidates.size() < words)
+      this->candidates.resize(words);
+    uint64_t * candidateWords = this->candidates.data();
+
+    for (unsigned int attempt = 0; attempt < CompatibleSampleAttempts; ++attempt)
+    {
+      indexes[0] = seeds[randomGenerator.uniformInteger(numberOfSeeds)];
+      std::copy(compatible + indexes[0] * words, compatible + (indexes[0] + 1) * words, candidateWords);
+      unsigned int l = 1;
+      for (; l < k; ++l)
+      {
+        size_t count = 0;
+        for (size_t w = 0; w < words; ++w)
+          count += PopCount(candidateWords[w]);
+        if (count == 0)
+          break;
+
+        // the chosen'th candidate
+        size_t chosen = randomGenerator.uniformInteger(static_cast<uint32_t>(count));
+        size_t w = 0;
+        for (size_t wordCount; chosen >= (wordCount = PopCount(candidateWords[w])); ++w)
+          chosen -= wordCount;
+        uint64_t word = candidateWords[w];
+        for (; chosen > 0; --chosen)
+          word &= word - 1;
+        indexes[l] = w * 64 + CountTrailingZeros(word);
+
+        const uint64_t * objectCompatible = compatible + indexes[l] * words;
+        for (size_t v = 0; v < words; ++v)
+          candidateWords[v] &= objectCompatible[v];
+      }
+      if (l == k)
+      {
+        std::sort(indexes, indexes + k);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static inline unsigned int
+  PopCount(uint64_t word)
+  {
+#if defined(_MSC_VER)
+    return static_cast<unsigned int>(__popcnt64(word));
+#else
+    return __builtin_popcountll(word);
+#endif
+  }
+
+  /** Index of the lowest set bit, the word must not be 0. */
+  static inline unsigned int
+  CountTrailingZeros(uint64_t word)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return __builtin_ctzll(word);
+#endif
+  }
+
+  /** Insert the index into the membership table, returns false if it was
+   * already there. */
+  bool
+  Insert(unsigned int index)
+  {
+    const size_t mask = this->keys.size() - 1;
+    // Fibonacci hashing, the high bits of the product are well mixed
+    size_t       slot = static_cast<uint32_t>(index * 0x9E3779B1u) >> this->shift;
+    while (this->stamps[slot] == this->stamp)
+    {
+      if (this->keys[slot] == index)
+        return false;
+      slot = (slot + 1) & mask;
+    }
+    this->stamps[slot] = this->stamp;
+    this->keys[slot] = index;
+    return true;
+  }
+
+  /** Empty the membership table in constant time. */
+  void
+  NextStamp()
+  {
+    if (++this->stamp == 0)
+    {
+      std::fill(this->stamps.begin(), this->stamps.end(), 0);
+      this->stamp = 1;
+    }
+  }
+
+  // subsets up to this size use a linear scan instead of the hash table
+  static constexpr unsigned int LinearScanSize = 16;
+  // seeds tried by SampleCompatible before giving up
+  static constexpr unsigned int CompatibleSampleAttempts = 16;
+
+  std::vector<unsigned int> keys;
+  std::vector<unsigned int> stamps;
+  unsigned int              stamp = 0;
+  unsigned int              shift = 28;
+  // objects compatible with all the ones drawn so far
+  std::vector<uint64_t> candidates;
+};
+
+} // end namespace itk
+
+#endif
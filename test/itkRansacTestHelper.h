@@ -0,0 +1,304 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#ifndef itkRansacTestHelper_h
+#define itkRansacTestHelper_h
+
+#include "itkRANSAC.h"
+#include "itkLandmarkRegistrationEstimator.h"
+#include "itkMesh.h"
+#include "itkMeshFileReader.h"
+#include "itkPoint.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+/**
+ * Data and setup shared by the RANSAC tests: the correspondences read from
+ * the test meshes, synthetic correspondences of a known motion, and the
+ * landmark registration estimator with RANSAC on top of it.
+ */
+namespace RansacTestHelper
+{
+
+constexpr unsigned int DimensionPoint = 6;
+using CorrespondenceType = itk::Point<double, DimensionPoint>;
+
+/** Print the usage and return false if the four meshes are not given. */
+inline bool
+CheckMeshArguments(int argc, char * argv[])
+{
+  if (argc < 5)
+  {
+    std::cerr << "Missing arguments." << std::endl;
+    std::cerr << "Usage: " << std::endl;
+    std::cerr << argv[0] << " movingFeatureMesh, "
+              << "fixedFeatureMesh, "
+              << "movingMesh, "
+              << "fixedMesh " << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Read the putative matches, point i of the fixed and of the moving feature
+ * mesh, into data and the points of the full meshes into agreeData.
+ */
+template <unsigned int Dimension>
+void
+GenerateData(std::vector<itk::Point<double, Dimension>> & data,
+             std::vector<itk::Point<double, Dimension>> & agreeData,
+             char *                                       movingFeatureMesh,
+             char *                                       fixedFeatureMesh,
+             char *                                       movingMesh,
+             char *                                       fixedMesh)
+{
+  // Read the two point sets that are the putative matches
+  using CoordinateType = double;
+  using MeshType = itk::Mesh<CoordinateType, 3>;
+  using ReaderType = itk::MeshFileReader<MeshType>;
+
+  auto reader1 = ReaderType::New();
+  reader1->SetFileName(fixedFeatureMesh);
+  reader1->Update();
+  auto mesh1 = reader1->GetOutput();
+
+  auto reader2 = ReaderType::New();
+  reader2->SetFileName(movingFeatureMesh);
+  reader2->Update();
+  auto mesh2 = reader2->GetOutput();
+
+  auto reader1_all = ReaderType::New();
+  reader1_all->SetFileName(fixedMesh);
+  reader1_all->Update();
+  auto mesh1_all = reader1_all->GetOutput();
+
+  auto reader2_all = ReaderType::New();
+  reader2_all->SetFileName(movingMesh);
+  reader2_all->Update();
+  auto mesh2_all = reader2_all->GetOutput();
+
+  data.reserve(mesh1->GetNumberOfPoints());
+
+  // Concatenate corressponding points from two meshes and insert in the data vector
+  using PointType = itk::Point<CoordinateType, 6>;
+  PointType p0;
+  for (unsigned int i = 0; i < mesh1->GetNumberOfPoints(); ++i)
+  {
+    auto point1 = mesh1->GetPoint(i);
+    auto point2 = mesh2->GetPoint(i);
+
+    p0[0] = point1[0];
+    p0[1] = point1[1];
+    p0[2] = point1[2];
+
+    p0[3] = point2[0];
+    p0[4] = point2[1];
+    p0[5] = point2[2];
+
+    data.push_back(p0);
+  }
+
+  unsigned int minCount = std::min(mesh1->GetNumberOfPoints(), mesh2->GetNumberOfPoints());
+  agreeData.reserve(minCount);
+  for (unsigned int i = 0; i < minCount; ++i)
+  {
+    auto point1 = mesh1_all->GetPoint(i);
+    auto point2 = mesh2_all->GetPoint(i);
+
+    p0[0] = point1[0];
+    p0[1] = point1[1];
+    p0[2] = point1[2];
+
+    p0[3] = point2[0];
+    p0[4] = point2[1];
+    p0[5] = point2[2];
+
+    agreeData.push_back(p0);
+  }
+}
+
+/**
+ * The landmark registration estimator, with minimal subsets of three
+ * correspondences and the inlier threshold inlierValue on agreeData, and
+ * RANSAC with it on data, drawing at most maxIteration hypotheses.
+ */
+template <typename TTransform>
+typename itk::RANSAC<CorrespondenceType, double, TTransform>::Pointer
+CreateRegistrationRANSAC(
+  std::vector<CorrespondenceType> &                                              data,
+  std::vector<CorrespondenceType> &                                              agreeData,
+  double                                                                         inlierValue,
+  unsigned int                                                                   maxIteration,
+  typename itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer & registrationEstimator)
+{
+  using RANSACType = itk::RANSAC<CorrespondenceType, double, TTransform>;
+
+  registrationEstimator = itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::New();
+  registrationEstimator->SetMinimalForEstimate(3);
+  registrationEstimator->SetDelta(inlierValue);
+  registrationEstimator->SetAgreeData(agreeData);
+
+  typename RANSACType::Pointer ransacEstimator = RANSACType::New();
+  ransacEstimator->SetData(data);
+  ransacEstimator->SetAgreeData(agreeData);
+  ransacEstimator->SetParametersEstimator(registrationEstimator.GetPointer());
+  ransacEstimator->SetMaxIteration(maxIteration);
+  return ransacEstimator;
+}
+
+/**
+ * The transform of an estimate, parameters holds the optimized parameters
+ * of TTransform followed by its fixed parameters.
+ */
+template <typename TTransform>
+typename TTransform::Pointer
+CreateTransform(const std::vector<double> & parameters)
+{
+  auto                                     transform = TTransform::New();
+  typename TTransform::ParametersType      optimizable = transform->GetParameters();
+  typename TTransform::FixedParametersType fixed = transform->GetFixedParameters();
+  for (unsigned int i = 0; i < optimizable.GetSize(); ++i)
+    optimizable[i] = parameters[i];
+  for (unsigned int i = 0; i < fixed.GetSize(); ++i)
+    fixed[i] = parameters[optimizable.GetSize() + i];
+  transform->SetFixedParameters(fixed);
+  transform->SetParameters(optimizable);
+  return transform;
+}
+
+/**
+ * Index of the moving point (coordinates 3..5) of agreeData nearest to
+ * point, found by a brute force search, and its squared distance.
+ */
+template <typename TPoint>
+unsigned int
+FindNearestMovingPoint(const std::vector<CorrespondenceType> & agreeData, const TPoint & point, double & distanceSquared)
+{
+  distanceSquared = std::numeric_limits<double>::max();
+  unsigned int nearest = 0;
+  for (unsigned int m = 0; m < agreeData.size(); ++m)
+  {
+    double distance = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      distance += (point[d] - agreeData[m][3 + d]) * (point[d] - agreeData[m][3 + d]);
+    if (distance < distanceSquared)
+    {
+      distanceSquared = distance;
+      nearest = m;
+    }
+  }
+  return nearest;
+}
+
+/** Rotation by angle about the z axis followed by a translation, the motion
+ * of the synthetic correspondences. */
+struct Motion
+{
+  double angle;
+  double translation[3];
+
+  void
+  Transform(const double fixed[3], double moving[3]) const
+  {
+    moving[0] = cos(this->angle) * fixed[0] - sin(this->angle) * fixed[1] + this->translation[0];
+    moving[1] = sin(this->angle) * fixed[0] + cos(this->angle) * fixed[1] + this->translation[1];
+    moving[2] = fixed[2] + this->translation[2];
+  }
+};
+
+/**
+ * Append count correspondences of the motion. drawFixedPoint(point) draws
+ * each fixed point, its moving point is the moved fixed point plus Gaussian
+ * noise of standard deviation noiseSigma (none if 0) in every coordinate.
+ */
+template <typename TFixedPointSampler>
+void
+AppendMotionCorrespondences(std::vector<CorrespondenceType> & data,
+                            unsigned int                      count,
+                            const Motion &                    motion,
+                            double                            noiseSigma,
+                            std::mt19937 &                    generator,
+                            TFixedPointSampler                drawFixedPoint)
+{
+  std::normal_distribution<double> noise(0.0, noiseSigma > 0.0 ? noiseSigma : 1.0);
+  CorrespondenceType               correspondence;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    double fixed[3], moving[3];
+    drawFixedPoint(fixed);
+    motion.Transform(fixed, moving);
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      correspondence[k] = fixed[k];
+      correspondence[k + 3] = noiseSigma > 0.0 ? moving[k] + noise(generator) : moving[k];
+    }
+    data.push_back(correspondence);
+  }
+}
+
+/** Append count random matches, all six coordinates uniform in
+ * [-extent, extent]. */
+inline void
+AppendRandomMatches(std::vector<CorrespondenceType> & data,
+                    unsigned int                      count,
+                    double                            extent,
+                    std::mt19937 &                    generator)
+{
+  std::uniform_real_distribution<double> uniform(-extent, extent);
+  CorrespondenceType                     correspondence;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    for (unsigned int k = 0; k < DimensionPoint; ++k)
+      correspondence[k] = uniform(generator);
+    data.push_back(correspondence);
+  }
+}
+
+/**
+ * numberOfInliers correspondences of the motion, fixed points uniform in
+ * [-extent, extent]^3 and noise of standard deviation noiseSigma, followed
+ * by numberOfOutliers random matches in the same cube.
+ */
+inline std::vector<CorrespondenceType>
+GenerateMotionData(unsigned int   numberOfInliers,
+                   unsigned int   numberOfOutliers,
+                   double         extent,
+                   const Motion & motion,
+                   double         noiseSigma,
+                   unsigned int   seed)
+{
+  std::mt19937                           generator(seed);
+  std::uniform_real_distribution<double> uniform(-extent, extent);
+
+  std::vector<CorrespondenceType> data;
+  data.reserve(numberOfInliers + numberOfOutliers);
+  AppendMotionCorrespondences(data, numberOfInliers, motion, noiseSigma, generator, [&](double point[3]) {
+    for (unsigned int k = 0; k < 3; ++k)
+      point[k] = uniform(generator);
+  });
+  AppendRandomMatches(data, numberOfOutliers, extent, generator);
+  return data;
+}
+
+} // namespace RansacTestHelper
+
+#endif
@@ -0,0 +1,88 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+
+
+/**
+ * Adaptive termination with a high inlier ratio: 80% of the correspondences
+ * follow a rigid motion. The bound on the number of tries for the desired
+ * probability is a handful of hypotheses, so the run must stop far below a
+ * large maxIteration and still find the motion.
+ */
+int
+itkRansacTest_AdaptiveTermination(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfInliers = 800;
+  const unsigned int             numberOfOutliers = 200;
+  const RansacTestHelper::Motion motion = { 0.3, { -15.0, 5.0, 10.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.05, 7);
+
+  double       inlierValue = 0.5;
+  unsigned int maxIteration = 100000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+
+  std::vector<double> transformParameters;
+  auto                result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  const size_t        iterations = ransacEstimator->GetNumberOfIterations();
+  std::cout << "Adaptive termination: " << iterations << " of " << maxIteration << " iterations, inlier ratio "
+            << (transformParameters.empty() ? 0.0 : result[0]) << std::endl;
+
+  if (iterations >= maxIteration / 100)
+  {
+    std::cerr << "The adaptive termination did not stop the search early." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (transformParameters.empty() || result[0] < 0.9 * numberOfInliers / (double)data.size())
+  {
+    std::cerr << "RANSAC did not find the motion." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the model maps the fixed points of the inliers as the motion does
+  auto   transform = RansacTestHelper::CreateTransform<TTransform>(transformParameters);
+  double maximumError = 0.0;
+  for (unsigned int i = 0; i < numberOfInliers; ++i)
+  {
+    TTransform::InputPointType point;
+    double                     fixed[3];
+    double                     expected[3];
+    for (unsigned int d = 0; d < 3; ++d)
+      point[d] = fixed[d] = data[i][d];
+    motion.Transform(fixed, expected);
+    TTransform::OutputPointType transformed = transform->TransformPoint(point);
+    for (unsigned int d = 0; d < 3; ++d)
+      maximumError = std::max(maximumError, std::abs(transformed[d] - expected[d]));
+  }
+  std::cout << "Largest error on the inliers " << maximumError << std::endl;
+  if (maximumError > inlierValue)
+  {
+    std::cerr << "The model is not the motion." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
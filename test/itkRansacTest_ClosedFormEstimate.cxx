@@ -0,0 +1,222 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkLandmarkBasedTransformInitializer.h"
+#include "itkImage.h"
+#include <algorithm>
+
+namespace
+{
+using PointType = RansacTestHelper::CorrespondenceType;
+
+// correspondences of random fixed points, the moving points are the fixed
+// ones mapped by the transform of the given parameters plus Gaussian noise
+template <typename TTransform>
+std::vector<PointType>
+GenerateCorrespondences(const std::vector<double> & parameters,
+                        unsigned int                numberOfPoints,
+                        double                      noiseSigma,
+                        std::mt19937 &              generator)
+{
+  auto                                   transform = RansacTestHelper::CreateTransform<TTransform>(parameters);
+  std::uniform_real_distribution<double> uniform(-50.0, 50.0);
+  std::normal_distribution<double>       noise(0.0, 1.0);
+
+  std::vector<PointType> data(numberOfPoints);
+  for (auto & correspondence : data)
+  {
+    typename TTransform::InputPointType fixedPoint;
+    for (unsigned int k = 0; k < 3; ++k)
+      fixedPoint[k] = uniform(generator);
+    const auto movingPoint = transform->TransformPoint(fixedPoint);
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      correspondence[k] = fixedPoint[k];
+      correspondence[k + 3] = movingPoint[k] + noiseSigma * noise(generator);
+    }
+  }
+  return data;
+}
+
+// parameters, in the layout of the estimator, found by the landmark based
+// transform initializer
+template <typename TTransform>
+std::vector<double>
+InitializerParameters(const std::vector<PointType> & data)
+{
+  using ImageType = itk::Image<float, 3>;
+  using InitializerType = itk::LandmarkBasedTransformInitializer<TTransform, ImageType, ImageType>;
+
+  typename InitializerType::LandmarkPointContainer fixedLandmarks;
+  typename InitializerType::LandmarkPointContainer movingLandmarks;
+  for (const auto & correspondence : data)
+  {
+    itk::Point<double, 3> fixedPoint, movingPoint;
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      fixedPoint[k] = correspondence[k];
+      movingPoint[k] = correspondence[k + 3];
+    }
+    fixedLandmarks.push_back(fixedPoint);
+    movingLandmarks.push_back(movingPoint);
+  }
+
+  auto transform = TTransform::New();
+  auto initializer = InitializerType::New();
+  initializer->SetFixedLandmarks(fixedLandmarks);
+  initializer->SetMovingLandmarks(movingLandmarks);
+  initializer->SetTransform(transform);
+  initializer->InitializeTransform();
+
+  std::vector<double> parameters;
+  const auto          optimizable = transform->GetParameters();
+  const auto          fixed = transform->GetFixedParameters();
+  for (unsigned int i = 0; i < optimizable.GetSize(); ++i)
+    parameters.push_back(optimizable[i]);
+  for (unsigned int i = 0; i < fixed.GetSize(); ++i)
+    parameters.push_back(fixed[i]);
+  return parameters;
+}
+
+// largest distance between the fixed points of data mapped by the two
+// parameter vectors, the versor sign and the center may differ
+template <typename TTransform>
+double
+MaximumDifference(const std::vector<double> & a, const std::vector<double> & b, const std::vector<PointType> & data)
+{
+  auto   transformA = RansacTestHelper::CreateTransform<TTransform>(a);
+  auto   transformB = RansacTestHelper::CreateTransform<TTransform>(b);
+  double maximum = 0.0;
+  for (const auto & correspondence : data)
+  {
+    typename TTransform::InputPointType fixedPoint;
+    for (unsigned int k = 0; k < 3; ++k)
+      fixedPoint[k] = correspondence[k];
+    const auto pointA = transformA->TransformPoint(fixedPoint);
+    const auto pointB = transformB->TransformPoint(fixedPoint);
+    for (unsigned int k = 0; k < 3; ++k)
+      maximum = std::max(maximum, std::abs(pointA[k] - pointB[k]));
+  }
+  return maximum;
+}
+
+template <typename TTransform>
+bool
+CheckClosedFormEstimate(const char * name, const std::vector<double> & trueParameters, double noiseSigma)
+{
+  const double tolerance = 1e-6;
+  std::mt19937 generator(5);
+  auto         estimator = itk::LandmarkRegistrationEstimator<RansacTestHelper::DimensionPoint, TTransform>::New();
+  estimator->SetMinimalForEstimate(3);
+
+  // least squares fit, the same optimum as the initializer
+  std::vector<PointType> data = GenerateCorrespondences<TTransform>(trueParameters, 50, noiseSigma, generator);
+  std::vector<double>    closedForm;
+  estimator->LeastSquaresEstimate(data, closedForm);
+  const std::vector<double> initializer = InitializerParameters<TTransform>(data);
+  const double              initializerDifference = closedForm.size() == initializer.size()
+                                                      ? MaximumDifference<TTransform>(closedForm, initializer, data)
+                                                      : -1.0;
+  std::cout << name << ": closed form and initializer differ by " << initializerDifference << std::endl;
+  if (!(initializerDifference >= 0.0 && initializerDifference < tolerance))
+  {
+    std::cerr << name << ": the closed form estimate is not the one of the initializer." << std::endl;
+    return false;
+  }
+
+  // exact estimate of a minimal subset of noise free correspondences
+  std::vector<PointType> minimalData = GenerateCorrespondences<TTransform>(trueParameters, 3, 0.0, generator);
+  std::vector<double>    minimal;
+  estimator->Estimate(minimalData, minimal);
+  if (minimal.size() != trueParameters.size() ||
+      MaximumDifference<TTransform>(minimal, trueParameters, data) > tolerance)
+  {
+    std::cerr << name << ": the minimal estimate is not the true transform." << std::endl;
+    return false;
+  }
+
+  // integer weights are the same fit as repeating every point weight times,
+  // points of zero weight are left out
+  std::uniform_int_distribution<unsigned int> weightDistribution(0, 3);
+  std::vector<double>                         weights;
+  std::vector<PointType>                      repeated;
+  for (const auto & correspondence : data)
+  {
+    weights.push_back(weightDistribution(generator));
+    for (unsigned int w = 0; w < weights.back(); ++w)
+      repeated.push_back(correspondence);
+  }
+  std::vector<double> weighted, duplicated;
+  estimator->WeightedLeastSquaresEstimate(data, weights, weighted);
+  estimator->LeastSquaresEstimate(repeated, duplicated);
+  if (weighted.size() != duplicated.size() || weighted.empty() ||
+      MaximumDifference<TTransform>(weighted, duplicated, data) > tolerance)
+  {
+    std::cerr << name << ": the weighted estimate is not the one of the repeated points." << std::endl;
+    return false;
+  }
+
+  // degenerate input gives empty parameters: all fixed points coincide, or
+  // no point has a weight
+  std::vector<PointType> coincident = data;
+  for (auto & correspondence : coincident)
+  {
+    for (unsigned int k = 0; k < 3; ++k)
+      correspondence[k] = data[0][k];
+  }
+  std::vector<double> degenerate(1, 0.0);
+  estimator->LeastSquaresEstimate(coincident, degenerate);
+  if (!degenerate.empty())
+  {
+    std::cerr << name << ": coincident fixed points gave a transform." << std::endl;
+    return false;
+  }
+  degenerate.assign(1, 0.0);
+  estimator->WeightedLeastSquaresEstimate(data, std::vector<double>(data.size(), 0.0), degenerate);
+  if (!degenerate.empty())
+  {
+    std::cerr << name << ": zero weights gave a transform." << std::endl;
+    return false;
+  }
+  return true;
+}
+} // namespace
+
+
+/**
+ * Compares the closed form estimate of the landmark estimator with the
+ * landmark based transform initializer it replaces for the versor rigid and
+ * similarity transforms, and checks minimal, weighted and degenerate input.
+ * The similarity transform is compared on exact correspondences only, the
+ * rigid one also on noisy ones, where both methods give the least squares
+ * fit.
+ */
+int
+itkRansacTest_ClosedFormEstimate(int, char *[])
+{
+  // [versor, translation, center]
+  const std::vector<double> rigidParameters = { 0.1, -0.2, 0.3, 5.0, -7.0, 2.0, 0.0, 0.0, 0.0 };
+  // [versor, translation, scale, center]
+  const std::vector<double> similarityParameters = { -0.3, 0.1, 0.2, 1.0, 4.0, -6.0, 1.3, 10.0, -5.0, 3.0 };
+
+  bool passed = CheckClosedFormEstimate<itk::VersorRigid3DTransform<double>>("VersorRigid3D", rigidParameters, 0.0);
+  passed &= CheckClosedFormEstimate<itk::VersorRigid3DTransform<double>>("VersorRigid3D noisy", rigidParameters, 0.5);
+  passed &= CheckClosedFormEstimate<itk::Similarity3DTransform<double>>("Similarity3D", similarityParameters, 0.0);
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
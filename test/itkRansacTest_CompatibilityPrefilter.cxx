@@ -0,0 +1,129 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+
+
+/**
+ * Correspondences with 95% outliers: a rigid motion with a little noise for
+ * 40 of them, random matches for the others. Uniform sampling with a budget
+ * of a few thousand hypotheses rarely draws three inliers, the clique of
+ * the compatibility graph must hold almost all the inliers and few
+ * outliers, and both the RANSAC run on the clique and the least squares fit
+ * to it must find the motion. A Compute that throws after the prefilter
+ * must still restore the full data.
+ */
+int
+itkRansacTest_CompatibilityPrefilter(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+  typedef itk::RANSAC<itk::Point<double, DimensionPoint>, double, TTransform> RANSACType;
+
+  const unsigned int             numberOfInliers = 40;
+  const unsigned int             numberOfOutliers = 760;
+  const RansacTestHelper::Motion motion = { 0.5, { 20.0, -10.0, 5.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.05, 3);
+
+  // the clique of the graph itself
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  itk::CompatibilityGraph         graph;
+  graph.Build(data[0].GetDataPointer(), DimensionPoint, data.size(), 0.95, threader);
+  std::vector<uint32_t> clique = graph.FindLargeClique();
+  unsigned int          inliersInClique = 0;
+  for (uint32_t i : clique)
+  {
+    if (i < numberOfInliers)
+      inliersInClique++;
+  }
+  std::cout << "Compatibility graph: " << graph.GetNumberOfEdges() << " edges, clique of " << clique.size()
+            << " with " << inliersInClique << " inliers" << std::endl;
+  if (inliersInClique < 0.9 * numberOfInliers || clique.size() - inliersInClique > 0.1 * numberOfInliers)
+  {
+    std::cerr << "The clique does not separate the inliers." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  double       inlierValue = 0.5;
+  unsigned int maxIteration = 2000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetCheckCorrespondenceEdgeLength(0.95);
+
+  const RANSACType::CompatibilityPrefilter prefilters[3] = { RANSACType::CompatibilityPrefilter::None,
+                                                             RANSACType::CompatibilityPrefilter::RANSAC,
+                                                             RANSACType::CompatibilityPrefilter::LeastSquares };
+  const char *        names[3] = { "None", "RANSAC", "LeastSquares" };
+  double              inlierRatio[3];
+  std::vector<double> unfilteredParameters;
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    ransacEstimator->SetCompatibilityPrefilter(prefilters[k]);
+
+    std::vector<double> transformParameters;
+    itk::TimeProbe      clock;
+    clock.Start();
+    auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+    inlierRatio[k] = transformParameters.empty() ? 0.0 : result[0];
+    if (k == 0)
+      unfilteredParameters = transformParameters;
+
+    std::cout << "Prefilter " << names[k] << ": " << ransacEstimator->GetNumberOfIterations() << " iterations in "
+              << clock.GetTotal() << " s, clique of " << ransacEstimator->GetCompatibleSetSize()
+              << ", inlier ratio " << inlierRatio[k] << std::endl;
+  }
+
+  const double expectedRatio = 0.9 * numberOfInliers / (double)data.size();
+  if (inlierRatio[1] < expectedRatio || inlierRatio[2] < expectedRatio)
+  {
+    std::cerr << "The prefiltered estimates did not find the motion." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the NAPSAC validation runs on the clique and throws, the run without the
+  // prefilter must then see all the data again and repeat the first result
+  ransacEstimator->SetCompatibilityPrefilter(RANSACType::CompatibilityPrefilter::RANSAC);
+  ransacEstimator->SetSamplingStrategy(RANSACType::SamplingStrategy::NAPSAC);
+  ransacEstimator->SetNeighborhoodSize(1);
+  std::vector<double> transformParameters;
+  bool                thrown = false;
+  try
+  {
+    ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  }
+  catch (const itk::ExceptionObject &)
+  {
+    thrown = true;
+  }
+  ransacEstimator->SetCompatibilityPrefilter(RANSACType::CompatibilityPrefilter::None);
+  ransacEstimator->SetSamplingStrategy(RANSACType::SamplingStrategy::Uniform);
+  ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  if (!thrown || transformParameters != unfilteredParameters)
+  {
+    std::cerr << "The data were not restored after the exception." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
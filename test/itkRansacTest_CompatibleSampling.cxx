@@ -0,0 +1,81 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+
+
+/**
+ * Compares uniform sampling with sampling of compatible subsets, both with
+ * the edge length test, on correspondences with 80% outliers and a budget
+ * of 50 hypotheses. Most uniform subsets hold an outlier and fail the test,
+ * compatible subsets always pass it and are far more often all inliers, so
+ * compatible sampling must find the motion in every run.
+ */
+int
+itkRansacTest_CompatibleSampling(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+  typedef itk::RANSAC<itk::Point<double, DimensionPoint>, double, TTransform> RANSACType;
+
+  const unsigned int             numberOfInliers = 100;
+  const unsigned int             numberOfOutliers = 400;
+  const RansacTestHelper::Motion motion = { 0.5, { 20.0, -10.0, 5.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.05, 11);
+
+  double       inlierValue = 0.5;
+  unsigned int maxIteration = 50;
+  double       desiredProbabilityForNoOutliers = 0.99;
+  const unsigned int numberOfRuns = 10;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetCheckCorrespondenceEdgeLength(0.95);
+
+  const double expectedRatio = 0.9 * numberOfInliers / (double)data.size();
+  unsigned int successes[2];
+  for (unsigned int useCompatible = 0; useCompatible < 2; ++useCompatible)
+  {
+    ransacEstimator->SetSamplingStrategy(useCompatible ? RANSACType::SamplingStrategy::Compatible
+                                                       : RANSACType::SamplingStrategy::Uniform);
+
+    successes[useCompatible] = 0;
+    for (unsigned int run = 0; run < numberOfRuns; ++run)
+    {
+      std::vector<double> transformParameters;
+      ransacEstimator->SetRandomSeed(run);
+      auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+      if (!transformParameters.empty() && result[0] >= expectedRatio)
+        successes[useCompatible]++;
+    }
+
+    std::cout << (useCompatible ? "Compatible" : "Uniform") << " sampling: motion found in "
+              << successes[useCompatible] << " of " << numberOfRuns << " runs of " << maxIteration
+              << " hypotheses" << std::endl;
+  }
+
+  if (successes[1] < numberOfRuns || successes[1] <= successes[0])
+  {
+    std::cerr << "Compatible sampling did not find the motion more reliably." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
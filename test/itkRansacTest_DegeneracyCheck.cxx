@@ -0,0 +1,105 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+
+
+/**
+ * Correspondences of a rigid motion where most fixed points lie close to a
+ * single line, the rotation about that line is not determined by them, plus
+ * random matches. Over several runs, with
+ * the conditioning test the nearly colinear subsets must be skipped before
+ * their estimate and counted, and the motion must still be found. Without
+ * the test nothing is counted.
+ */
+int
+itkRansacTest_DegeneracyCheck(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfLinePoints = 300;
+  const unsigned int             numberOfOtherPoints = 100;
+  const unsigned int             numberOfOutliers = 200;
+  const RansacTestHelper::Motion motion = { 0.5, { 20.0, -10.0, 5.0 } };
+
+  std::mt19937                           generator(5);
+  std::uniform_real_distribution<double> uniform(-100.0, 100.0);
+  std::normal_distribution<double>       offLine(0.0, 0.01);
+
+  // exact correspondences of fixed points along the direction (1, 1, 1),
+  // then of fixed points anywhere, then random matches
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  RansacTestHelper::AppendMotionCorrespondences(data, numberOfLinePoints, motion, 0.0, generator, [&](double point[3]) {
+    const double t = uniform(generator);
+    for (unsigned int k = 0; k < 3; ++k)
+      point[k] = t + offLine(generator);
+  });
+  RansacTestHelper::AppendMotionCorrespondences(data, numberOfOtherPoints, motion, 0.0, generator, [&](double point[3]) {
+    for (unsigned int k = 0; k < 3; ++k)
+      point[k] = uniform(generator);
+  });
+  RansacTestHelper::AppendRandomMatches(data, numberOfOutliers, 100.0, generator);
+
+  double       inlierValue = 0.1;
+  unsigned int maxIteration = 500;
+  double       desiredProbabilityForNoOutliers = 0.999999;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+
+  const unsigned int numberOfRuns = 10;
+  double             inlierRatio[2];
+  size_t             degenerate[2];
+  size_t             iterations[2];
+  const double       thresholds[2] = { 0.0, 1e-4 };
+  for (unsigned int k = 0; k < 2; ++k)
+  {
+    ransacEstimator->SetDegeneracyThreshold(thresholds[k]);
+    inlierRatio[k] = 1.0;
+    degenerate[k] = 0;
+    iterations[k] = 0;
+    for (unsigned int run = 0; run < numberOfRuns; ++run)
+    {
+      std::vector<double> transformParameters;
+      ransacEstimator->SetRandomSeed(run);
+      auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+      inlierRatio[k] = std::min(inlierRatio[k], transformParameters.empty() ? 0.0 : result[0]);
+      degenerate[k] += ransacEstimator->GetNumberOfDegenerateSubSets();
+      iterations[k] += ransacEstimator->GetNumberOfIterations();
+    }
+
+    std::cout << "Degeneracy threshold " << thresholds[k] << ": " << iterations[k] << " iterations, " << degenerate[k]
+              << " degenerate subsets skipped, lowest inlier ratio " << inlierRatio[k] << std::endl;
+  }
+
+  // three points of the line are drawn in 1 of 8 subsets
+  if (degenerate[0] != 0 || degenerate[1] < 0.05 * iterations[1])
+  {
+    std::cerr << "The degenerate subsets were not counted." << std::endl;
+    return EXIT_FAILURE;
+  }
+  const double expectedRatio = (numberOfLinePoints + numberOfOtherPoints) / (double)data.size();
+  if (inlierRatio[1] < 0.99 * expectedRatio)
+  {
+    std::cerr << "The motion was not found with the conditioning test." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include <algorithm>
+
+
+/**
+ * Few correspondences of a rigid motion, most of them outliers, so that all
+ * the C(30, 3) subsets fit in the iteration budget. The enumeration must
+ * visit every subset exactly once, give the same model whatever the number
+ * of threads and find at least as many inliers as random sampling.
+ */
+int
+itkRansacTest_ExhaustiveEnumeration(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfInliers = 8;
+  const unsigned int             numberOfOutliers = 22;
+  const RansacTestHelper::Motion motion = { 0.3, { 5.0, 2.0, -3.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 50.0, motion, 0.01, 11);
+
+  double       inlierValue = 0.1;
+  unsigned int maxIteration = 5000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+  const size_t numberOfSubSets = 30 * 29 * 28 / 6;
+
+  const unsigned int numberOfThreads[2] = { std::min(4u, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads()), 1 };
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetNumberOfThreads(numberOfThreads[0]);
+
+  // random sampling with the same budget, stops once confident
+  std::vector<double> sampledParameters;
+  ransacEstimator->SetRandomSeed(1);
+  auto         sampledResult = ransacEstimator->Compute(sampledParameters, desiredProbabilityForNoOutliers);
+  const double sampledRatio = sampledParameters.empty() ? 0.0 : sampledResult[0];
+  std::cout << "Random sampling: " << ransacEstimator->GetNumberOfIterations() << " iterations, inlier ratio "
+            << sampledRatio << std::endl;
+
+  ransacEstimator->SetUseExhaustiveEnumeration(true);
+  std::vector<double> enumeratedParameters[2];
+  double              enumeratedRatio[2];
+  for (unsigned int k = 0; k < 2; ++k)
+  {
+    ransacEstimator->SetNumberOfThreads(numberOfThreads[k]);
+    auto result = ransacEstimator->Compute(enumeratedParameters[k], desiredProbabilityForNoOutliers);
+    enumeratedRatio[k] = enumeratedParameters[k].empty() ? 0.0 : result[0];
+    std::cout << "Enumeration with " << numberOfThreads[k] << " threads: " << ransacEstimator->GetNumberOfIterations()
+              << " iterations, inlier ratio " << enumeratedRatio[k] << std::endl;
+
+    if (ransacEstimator->GetNumberOfIterations() != numberOfSubSets)
+    {
+      std::cerr << "The enumeration did not visit every subset once." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (enumeratedParameters[0].size() != enumeratedParameters[1].size())
+  {
+    std::cerr << "The enumeration depends on the number of threads." << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < enumeratedParameters[0].size(); ++i)
+  {
+    if (std::abs(enumeratedParameters[0][i] - enumeratedParameters[1][i]) > 1e-9)
+    {
+      std::cerr << "The enumeration depends on the number of threads." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  const double expectedRatio = numberOfInliers / (double)data.size();
+  if (enumeratedRatio[0] < sampledRatio || enumeratedRatio[0] < expectedRatio)
+  {
+    std::cerr << "The enumeration missed the motion." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+#include <algorithm>
+
+
+/**
+ * Scaling test for the global iteration budget. With the budget shared by
+ * all threads the total number of hypotheses and the model found must not
+ * depend on the number of threads. With per-thread budgets every thread runs
+ * maxIteration iterations on its own. The run times are only printed.
+ */
+int
+itkRansacTest_GlobalIterationBudget(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+  std::vector<double>                             transformParameters;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  // the inlier ratio and the probability are such that the adaptive bound
+  // never ends the search early
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 1000;
+  double       desiredProbabilityForNoOutliers = 0.999999;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  // at most the global default number of threads
+  unsigned int maxThreads = std::min(4u, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+
+  // per-thread budgets, the work grows with the number of threads
+  ransacEstimator->SetUseGlobalIterationBudget(false);
+  ransacEstimator->SetNumberOfThreads(maxThreads);
+  ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  std::cout << "Per-thread budget, " << maxThreads << " threads: "
+            << ransacEstimator->GetNumberOfIterations() << " iterations" << std::endl;
+  if (ransacEstimator->GetNumberOfIterations() != (size_t)maxIteration * maxThreads)
+  {
+    std::cerr << "Expected " << (size_t)maxIteration * maxThreads << " iterations." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // global budget, the work is the same for any number of threads
+  ransacEstimator->SetUseGlobalIterationBudget(true);
+  std::vector<double> maxThreadsParameters;
+  double              timeForOneThread = 0.0;
+  double              timeForMaxThreads = 0.0;
+  for (unsigned int numberOfThreads = maxThreads; numberOfThreads >= 1; numberOfThreads /= 2)
+  {
+    ransacEstimator->SetNumberOfThreads(numberOfThreads);
+
+    itk::TimeProbe clock;
+    clock.Start();
+    ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    std::cout << "Global budget, " << numberOfThreads << " threads: "
+              << ransacEstimator->GetNumberOfIterations() << " iterations in "
+              << clock.GetTotal() << " s" << std::endl;
+    if (ransacEstimator->GetNumberOfIterations() != maxIteration)
+    {
+      std::cerr << "Expected " << maxIteration << " iterations." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (transformParameters.empty())
+    {
+      std::cerr << "RANSAC estimate failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (numberOfThreads == maxThreads)
+    {
+      maxThreadsParameters = transformParameters;
+      timeForMaxThreads = clock.GetTotal();
+    }
+    else if (transformParameters != maxThreadsParameters)
+    {
+      std::cerr << "The model depends on the number of threads." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (numberOfThreads == 1)
+      timeForOneThread = clock.GetTotal();
+  }
+
+  std::cout << "Speedup with " << maxThreads << " threads: " << timeForOneThread / timeForMaxThreads << std::endl;
+  return EXIT_SUCCESS;
+}
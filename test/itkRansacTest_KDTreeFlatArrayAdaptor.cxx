@@ -0,0 +1,197 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkKDTreeFlatArrayAdaptor.h"
+#include "itkLandmarkRegistrationEstimator.h"
+#include "itkVersorRigid3DTransform.h"
+#include "itkPoint.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+namespace
+{
+// index and squared distance of the point of the 6D correspondences (moving
+// point in coordinates 3..5) nearest to the query
+unsigned int
+BruteForceNearest(const std::vector<double> & correspondences, const double * query, double & nearestDistance)
+{
+  nearestDistance = std::numeric_limits<double>::max();
+  unsigned int nearest = 0;
+  for (unsigned int i = 0; i < correspondences.size() / 6; ++i)
+  {
+    double distance = 0.0;
+    for (unsigned int k = 0; k < 3; ++k)
+      distance += (correspondences[6 * i + 3 + k] - query[k]) * (correspondences[6 * i + 3 + k] - query[k]);
+    if (distance < nearestDistance)
+    {
+      nearestDistance = distance;
+      nearest = i;
+    }
+  }
+  return nearest;
+}
+} // namespace
+
+
+/**
+ * Compares the radius bounded query of the flat kd-tree adaptor with a brute
+ * force search. The points are read with a stride and an offset, the layout
+ * of the landmark estimator's agree data. The nearest point mode must find a
+ * point exactly when one lies within the radius, and the nearest one. The
+ * first hit mode must find the same queries, with a distance that is only an
+ * upper bound of the nearest one; the estimator's SetCountInliersOnly(true)
+ * must give the same inliers as the exact count in the same way.
+ */
+int
+itkRansacTest_KDTreeFlatArrayAdaptor(int, char *[])
+{
+  const unsigned int numberOfPoints = 5000;
+  const unsigned int numberOfQueries = 20000;
+  const double       radius = 5.0;
+  const double       radiusSquared = radius * radius;
+
+  std::mt19937                           generator(8);
+  std::uniform_real_distribution<double> uniform(-100.0, 100.0);
+  // some queries fall outside the bounding box of the points, within the
+  // radius of it or farther
+  std::uniform_real_distribution<double> queryUniform(-110.0, 110.0);
+
+  // 6D correspondences, the first 3 coordinates are the queries of the
+  // estimator, the tree holds the last 3
+  std::vector<double> correspondences(6 * numberOfPoints);
+  for (auto & coordinate : correspondences)
+    coordinate = uniform(generator);
+
+  itk::KDTreeFlatArrayAdaptor<double, 3> adaptor;
+  adaptor.SetPoints(correspondences.data() + 3, 6, numberOfPoints);
+
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+  {
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      if (adaptor.GetPoint(i)[k] != correspondences[6 * i + 3 + k])
+      {
+        std::cerr << "The adaptor did not copy point " << i << "." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  unsigned int hits = 0;
+  unsigned int wrong = 0;
+  unsigned int wrongFirstHit = 0;
+  unsigned int notNearestFirstHit = 0;
+  double       query[3];
+  for (unsigned int q = 0; q < numberOfQueries; ++q)
+  {
+    for (unsigned int k = 0; k < 3; ++k)
+      query[k] = queryUniform(generator);
+
+    double       nearestDistance;
+    unsigned int nearest = BruteForceNearest(correspondences, query, nearestDistance);
+    const bool   within = nearestDistance < radiusSquared;
+
+    uint32_t index;
+    double   distanceSquared;
+    bool     found = adaptor.FindNeighborWithinRadius(query, radiusSquared, false, index, distanceSquared);
+    if (found != within ||
+        (found && (index != nearest || std::abs(distanceSquared - nearestDistance) > 1e-9 * radiusSquared)))
+      wrong++;
+    if (within)
+      hits++;
+
+    // any point within the radius, reported with its own distance
+    found = adaptor.FindNeighborWithinRadius(query, radiusSquared, true, index, distanceSquared);
+    if (found != within)
+    {
+      wrongFirstHit++;
+      continue;
+    }
+    if (!found)
+      continue;
+    double pointDistance = 0.0;
+    for (unsigned int k = 0; k < 3; ++k)
+      pointDistance += (adaptor.GetPoint(index)[k] - query[k]) * (adaptor.GetPoint(index)[k] - query[k]);
+    if (distanceSquared >= radiusSquared || std::abs(distanceSquared - pointDistance) > 1e-9 * radiusSquared ||
+        distanceSquared < nearestDistance - 1e-9 * radiusSquared)
+      wrongFirstHit++;
+    else if (index != nearest)
+      notNearestFirstHit++;
+  }
+
+  std::cout << hits << " of " << numberOfQueries << " queries within the radius, " << wrong
+            << " nearest and " << wrongFirstHit << " first hit results differ from the brute force search, "
+            << notNearestFirstHit << " first hits are not the nearest point" << std::endl;
+  if (wrong != 0 || hits < numberOfQueries / 10)
+  {
+    std::cerr << "The radius query does not return the nearest point." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (wrongFirstHit != 0)
+  {
+    std::cerr << "The first hit query does not return a point within the radius." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the estimator queries the tree with the first 3 coordinates of every
+  // correspondence, the identity leaves them unchanged
+  constexpr unsigned int DimensionPoint = 6;
+  using TTransform = itk::VersorRigid3DTransform<double>;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData(numberOfPoints);
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+  {
+    for (unsigned int k = 0; k < DimensionPoint; ++k)
+      agreeData[i][k] = correspondences[DimensionPoint * i + k];
+  }
+  std::vector<double> identity(9, 0.0); // [versor, translation, center]
+
+  auto registrationEstimator = itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::New();
+  registrationEstimator->SetMinimalForEstimate(3);
+  registrationEstimator->SetDelta(radius);
+  registrationEstimator->SetAgreeData(agreeData);
+  std::vector<double> exact = registrationEstimator->AgreeMultiple(identity, agreeData, 0);
+  registrationEstimator->SetCountInliersOnly(true);
+  std::vector<double> bound = registrationEstimator->AgreeMultiple(identity, agreeData, 0);
+
+  unsigned int inliers = 0;
+  unsigned int wrongEstimator = 0;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+  {
+    double nearestDistance;
+    BruteForceNearest(correspondences, correspondences.data() + DimensionPoint * i, nearestDistance);
+    const bool within = nearestDistance < radiusSquared;
+    inliers += within ? 1 : 0;
+    if ((exact[i] >= 0.0) != within || (bound[i] >= 0.0) != within)
+      wrongEstimator++;
+    else if (within && (std::abs(exact[i] - nearestDistance) > 1e-9 * radiusSquared ||
+                        bound[i] < exact[i] - 1e-9 * radiusSquared || bound[i] >= radiusSquared))
+      wrongEstimator++;
+  }
+
+  std::cout << inliers << " of " << numberOfPoints << " correspondences are inliers, " << wrongEstimator
+            << " estimator results differ from the brute force search" << std::endl;
+  if (wrongEstimator != 0 || inliers == 0)
+  {
+    std::cerr << "Counting the inliers only changes the inliers." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+
+
+/**
+ * Runs RANSAC with and without the local optimization of LO-RANSAC. The
+ * refined model must have at least the support of the plain one and should
+ * need fewer hypotheses. The inner least squares fits use the fixed points
+ * the estimator matched to the inliers, these must be the nearest ones.
+ */
+int
+itkRansacTest_LocalOptimization(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+  std::vector<double>                             transformParameters;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 20000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  double inlierRatio[2];
+  size_t iterations[2];
+  for (unsigned int useLO = 0; useLO < 2; ++useLO)
+  {
+    ransacEstimator->SetUseLocalOptimization(useLO == 1);
+
+    itk::TimeProbe clock;
+    clock.Start();
+    auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    if (transformParameters.empty())
+    {
+      std::cerr << "RANSAC estimate failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+    inlierRatio[useLO] = result[0];
+    iterations[useLO] = ransacEstimator->GetNumberOfIterations();
+
+    std::cout << (useLO ? "With" : "Without") << " local optimization: " << iterations[useLO]
+              << " iterations in " << clock.GetTotal() << " s, inlier ratio " << result[0] << ", "
+              << ransacEstimator->GetNumberOfLocalOptimizations() << " local optimizations" << std::endl;
+  }
+
+  if (inlierRatio[1] < inlierRatio[0])
+  {
+    std::cerr << "The local optimization lost support." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the correspondences of the inliers of the refined model, as the local
+  // optimization gets them, against a brute force search. A wider threshold
+  // gives several candidate fixed points per query
+  const double checkDelta = 4.0 * inlierValue;
+  registrationEstimator->SetDelta(checkDelta);
+  itk::SequentialProbabilityRatioTest fullTest;
+  bool                                rejected;
+  unsigned int                        numberOfTested;
+  double                              score;
+  std::vector<unsigned int>           correspondences;
+  auto result = registrationEstimator->AgreeMultipleSequential(
+    transformParameters, agreeData, 0.0, fullTest, rejected, numberOfTested, score, &correspondences);
+
+  auto transform = RansacTestHelper::CreateTransform<TTransform>(transformParameters);
+
+  unsigned int inliers = 0;
+  unsigned int notNearest = 0;
+  for (unsigned int i = 0; i < agreeData.size(); ++i)
+  {
+    if (result[i] < 0.0)
+      continue;
+    inliers++;
+
+    TTransform::InputPointType point;
+    for (unsigned int d = 0; d < 3; ++d)
+      point[d] = agreeData[i][d];
+    double       nearestDistance;
+    unsigned int nearest =
+      RansacTestHelper::FindNearestMovingPoint(agreeData, transform->TransformPoint(point), nearestDistance);
+    if (correspondences[i] != nearest && std::abs(result[i] - nearestDistance) > 1e-9 * checkDelta * checkDelta)
+      notNearest++;
+  }
+
+  std::cout << notNearest << " of the " << inliers << " matches of the refined model are not the nearest point"
+            << std::endl;
+  if (inliers == 0 || notNearest != 0)
+  {
+    std::cerr << "The local optimization fits to points that are not the nearest ones." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
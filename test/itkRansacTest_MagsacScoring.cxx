@@ -0,0 +1,157 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRANSAC.h"
+#include "itkLandmarkRegistrationEstimator.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <iostream>
+
+
+/**
+ * Compares a sweep of inlier thresholds with the inlier count against a
+ * single MAGSAC run whose threshold is the largest one of the sweep. The
+ * correspondences are a rigid motion with Gaussian noise plus random
+ * matches, the error of an estimate is the RMS distance between the
+ * transformed fixed points of the true matches and their noise free moving
+ * points. MAGSAC must come close to the best threshold of the sweep and
+ * beat the inlier count at the same threshold.
+ */
+int
+itkRansacTest_MagsacScoring(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = 6;
+  typedef itk::RANSAC<itk::Point<double, DimensionPoint>, double, TTransform> RANSACType;
+  using EstimatorType = itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>;
+
+  const unsigned int numberOfInliers = 400;
+  const unsigned int numberOfOutliers = 400;
+  const double       extent = 100.0;
+  const double       angle = 0.4;
+  const double       translation[3] = { 5.0, -3.0, 2.0 };
+
+  std::mt19937                           generator(7);
+  std::uniform_real_distribution<double> uniform(-extent, extent);
+  std::normal_distribution<double>       noise(0.0, 0.3);
+
+  auto transformPoint = [&](const double in[3], double out[3]) {
+    out[0] = cos(angle) * in[0] - sin(angle) * in[1] + translation[0];
+    out[1] = sin(angle) * in[0] + cos(angle) * in[1] + translation[1];
+    out[2] = in[2] + translation[2];
+  };
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  itk::Point<double, DimensionPoint>              correspondence;
+  for (unsigned int i = 0; i < numberOfInliers + numberOfOutliers; ++i)
+  {
+    double fixed[3], moving[3];
+    for (unsigned int k = 0; k < 3; ++k)
+      fixed[k] = uniform(generator);
+    if (i < numberOfInliers)
+    {
+      transformPoint(fixed, moving);
+      for (unsigned int k = 0; k < 3; ++k)
+        moving[k] += noise(generator);
+    }
+    else
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+        moving[k] = uniform(generator);
+    }
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      correspondence[k] = fixed[k];
+      correspondence[k + 3] = moving[k];
+    }
+    data.push_back(correspondence);
+  }
+
+  auto estimateError = [&](const std::vector<double> & parameters) {
+    EstimatorType::TransformKernel kernel;
+    EstimatorType::ComputeTransformKernel(parameters, kernel);
+    double sumOfSquares = 0.0;
+    for (unsigned int i = 0; i < numberOfInliers; ++i)
+    {
+      double fixed[3], moving[3];
+      for (unsigned int k = 0; k < 3; ++k)
+        fixed[k] = data[i][k];
+      transformPoint(fixed, moving);
+      for (unsigned int k = 0; k < 3; ++k)
+      {
+        double estimated = kernel.offset[k];
+        for (unsigned int l = 0; l < 3; ++l)
+          estimated += kernel.matrix[k][l] * fixed[l];
+        sumOfSquares += (estimated - moving[k]) * (estimated - moving[k]);
+      }
+    }
+    return sqrt(sumOfSquares / numberOfInliers);
+  };
+
+  int ransacPoints = 3;
+  unsigned int maxIteration = 5000;
+  double desiredProbabilityForNoOutliers = 0.99;
+  const double thresholds[6] = { 0.5, 1.0, 1.5, 2.0, 3.0, 4.0 };
+
+  auto   registrationEstimator = EstimatorType::New();
+  registrationEstimator->SetMinimalForEstimate(ransacPoints);
+  registrationEstimator->SetAgreeData(data);
+
+  RANSACType::Pointer ransacEstimator = RANSACType::New();
+  ransacEstimator->SetData(data);
+  ransacEstimator->SetAgreeData(data);
+  ransacEstimator->SetParametersEstimator(registrationEstimator);
+  ransacEstimator->SetMaxIteration(maxIteration);
+
+  std::vector<double> transformParameters;
+  double              bestSweepError = std::numeric_limits<double>::max();
+  double              largestThresholdError = 0.0;
+  for (double threshold : thresholds)
+  {
+    registrationEstimator->SetDelta(threshold);
+    registrationEstimator->SetScoringMethod(EstimatorType::ScoringMethod::RANSAC);
+    ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    if (transformParameters.empty())
+    {
+      std::cerr << "RANSAC estimate failed at threshold " << threshold << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+    const double error = estimateError(transformParameters);
+    bestSweepError = std::min(bestSweepError, error);
+    largestThresholdError = error;
+    std::cout << "RANSAC, threshold " << threshold << ": error " << error << std::endl;
+  }
+
+  registrationEstimator->SetScoringMethod(EstimatorType::ScoringMethod::MAGSAC);
+  ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  if (transformParameters.empty())
+  {
+    std::cerr << "MAGSAC estimate failed." << std::endl;
+    return EXIT_FAILURE;
+  }
+  const double magsacError = estimateError(transformParameters);
+  std::cout << "MAGSAC, threshold " << thresholds[5] << ": error " << magsacError << std::endl;
+
+  if (magsacError > 1.5 * bestSweepError || magsacError >= largestThresholdError)
+  {
+    std::cerr << "MAGSAC did not replace the threshold sweep." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+
+
+/**
+ * Compares uniform sampling with NAPSAC on correspondences of a body made of
+ * several rigid parts, each moved by its own rotation and translation, plus
+ * random matches. A uniform triple rarely falls on a single part while the
+ * neighbours of a seed mostly do, so with the same small number of
+ * hypotheses NAPSAC must find models with larger support on average.
+ */
+int
+itkRansacTest_NeighborhoodSampling(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+  typedef itk::RANSAC<itk::Point<double, DimensionPoint>, double, TTransform> RANSACType;
+
+  const unsigned int numberOfParts = 4;
+  const unsigned int pointsPerPart = 150;
+  const unsigned int numberOfOutliers = 200;
+  const double       partRadius = 20.0;
+  const double       partSpacing = 100.0;
+
+  std::mt19937                           generator(42);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+
+  // fixed points inside a ball around the center of a part
+  auto randomPointOfPart = [&](unsigned int part, double point[3]) {
+    do
+    {
+      for (unsigned int k = 0; k < 3; ++k)
+        point[k] = uniform(generator);
+    } while (point[0] * point[0] + point[1] * point[1] + point[2] * point[2] > 1.0);
+    for (unsigned int k = 0; k < 3; ++k)
+      point[k] *= partRadius;
+    point[0] += part * partSpacing;
+  };
+
+  // a rotation about z and a translation per part
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  for (unsigned int part = 0; part < numberOfParts; ++part)
+  {
+    const RansacTestHelper::Motion motion = { 0.3 * (part + 1), { 10.0 * part, -5.0, 3.0 * part } };
+    RansacTestHelper::AppendMotionCorrespondences(
+      data, pointsPerPart, motion, 0.2, generator, [&](double point[3]) { randomPointOfPart(part, point); });
+  }
+  itk::Point<double, DimensionPoint> correspondence;
+  for (unsigned int i = 0; i < numberOfOutliers; ++i)
+  {
+    double point[3];
+    randomPointOfPart(i % numberOfParts, point);
+    for (unsigned int k = 0; k < 3; ++k)
+    {
+      correspondence[k] = point[k];
+      correspondence[k + 3] = numberOfParts * partSpacing * 0.5 * (uniform(generator) + 1.0);
+    }
+    data.push_back(correspondence);
+  }
+
+  double             inlierValue = 1.0;
+  unsigned int       maxIteration = 20;
+  double             desiredProbabilityForNoOutliers = 0.99;
+  const unsigned int numberOfRuns = 20;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetNeighborhoodSize(16);
+
+  double meanInlierRatio[2];
+  for (unsigned int useNapsac = 0; useNapsac < 2; ++useNapsac)
+  {
+    ransacEstimator->SetSamplingStrategy(useNapsac ? RANSACType::SamplingStrategy::NAPSAC
+                                                   : RANSACType::SamplingStrategy::Uniform);
+
+    meanInlierRatio[useNapsac] = 0.0;
+    for (unsigned int run = 0; run < numberOfRuns; ++run)
+    {
+      std::vector<double> transformParameters;
+      ransacEstimator->SetRandomSeed(run);
+      auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+      meanInlierRatio[useNapsac] += result[0] / numberOfRuns;
+    }
+
+    std::cout << (useNapsac ? "NAPSAC" : "Uniform") << " sampling: mean inlier ratio "
+              << meanInlierRatio[useNapsac] << " after " << maxIteration << " hypotheses" << std::endl;
+  }
+
+  // a single part holds 150 of the 800 correspondences
+  if (meanInlierRatio[1] < 0.15 || meanInlierRatio[1] < 1.5 * meanInlierRatio[0])
+  {
+    std::cerr << "NAPSAC did not find better models than uniform sampling." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
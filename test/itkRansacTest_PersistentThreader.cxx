@@ -0,0 +1,100 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkPoolMultiThreader.h"
+#include "itkTimeProbe.h"
+#include <algorithm>
+
+
+/**
+ * Many small registrations in a row, as when registering a stream of
+ * scans. The threader given to RANSAC must be the one every call runs on,
+ * the global default number of threads must not change, and for one thread
+ * the result must be the one of the threader RANSAC creates itself.
+ */
+int
+itkRansacTest_PersistentThreader(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfInliers = 700;
+  const unsigned int             numberOfOutliers = 300;
+  const RansacTestHelper::Motion motion = { 0.2, { -4.0, 7.0, 1.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.01, 3);
+
+  double       inlierValue = 0.1;
+  unsigned int maxIteration = 100;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  const unsigned int globalDefaultNumberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  const unsigned int numberOfThreads = std::min(2u, globalDefaultNumberOfThreads);
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+
+  // threads started once for all the calls
+  itk::MultiThreaderBase::Pointer threader = itk::PoolMultiThreader::New().GetPointer();
+  ransacEstimator->SetMultiThreader(threader);
+
+  const unsigned int  numberOfCalls = 200;
+  std::vector<double> transformParameters;
+  itk::TimeProbe      clock;
+  for (unsigned int call = 0; call < numberOfCalls; ++call)
+  {
+    // alternate between one thread and more
+    ransacEstimator->SetNumberOfThreads(call % 2 ? numberOfThreads : 1);
+    clock.Start();
+    ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    if (ransacEstimator->GetMultiThreader() != threader.GetPointer() ||
+        threader->GetNumberOfWorkUnits() != ransacEstimator->GetNumberOfThreads())
+    {
+      std::cerr << "The registrations did not run on the given threader." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads() != globalDefaultNumberOfThreads)
+    {
+      std::cerr << "The global default number of threads changed." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::cout << numberOfCalls << " registrations of " << data.size() << " correspondences, "
+            << 1e3 * clock.GetTotal() / numberOfCalls << " ms each" << std::endl;
+
+  // the threader does not change the result for a fixed seed
+  std::vector<double> parameters[2];
+  for (unsigned int k = 0; k < 2; ++k)
+  {
+    ransacEstimator->SetMultiThreader(k == 0 ? threader.GetPointer() : nullptr);
+    ransacEstimator->SetNumberOfThreads(1);
+    ransacEstimator->SetRandomSeed(7);
+    ransacEstimator->Compute(parameters[k], desiredProbabilityForNoOutliers);
+  }
+  if (parameters[0] != parameters[1] || ransacEstimator->GetMultiThreader() == threader.GetPointer())
+  {
+    std::cerr << "The default threader gave another result." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
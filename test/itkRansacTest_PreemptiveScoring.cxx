@@ -0,0 +1,93 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+
+
+/**
+ * Compares the adaptive RANSAC with preemptive scoring on the same number of
+ * hypotheses. The preemptive run scores each hypothesis on a few blocks of
+ * the agree data only, it must check far fewer objects than scoring every
+ * hypothesis on all of them and still find a model with most of the support
+ * of the adaptive one. The run times are only printed.
+ */
+int
+itkRansacTest_PreemptiveScoring(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+  std::vector<double>                             transformParameters;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 20000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  // the adaptive run decides the number of hypotheses of the preemptive one
+  itk::TimeProbe adaptiveClock;
+  adaptiveClock.Start();
+  auto adaptiveResult = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  adaptiveClock.Stop();
+  const size_t iterations = ransacEstimator->GetNumberOfIterations();
+  std::cout << "Adaptive: " << iterations << " hypotheses in " << adaptiveClock.GetTotal()
+            << " s, inlier ratio " << adaptiveResult[0] << std::endl;
+
+  ransacEstimator->SetUsePreemptiveScoring(true);
+  const unsigned int blockSize = 100;
+  ransacEstimator->SetPreemptionBlockSize(blockSize);
+  ransacEstimator->SetMaxIteration(iterations);
+  itk::TimeProbe preemptiveClock;
+  preemptiveClock.Start();
+  auto preemptiveResult = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+  preemptiveClock.Stop();
+  std::cout << "Preemptive: " << ransacEstimator->GetNumberOfIterations() << " hypotheses in "
+            << preemptiveClock.GetTotal() << " s, inlier ratio " << preemptiveResult[0] << std::endl;
+
+  if (transformParameters.empty() || ransacEstimator->GetNumberOfIterations() != iterations)
+  {
+    std::cerr << "Preemptive RANSAC estimate failed." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (preemptiveResult[0] < 0.8 * adaptiveResult[0])
+  {
+    std::cerr << "Preemptive scoring lost too much support." << std::endl;
+    return EXIT_FAILURE;
+  }
+  // half the hypotheses are dropped after each block
+  const size_t verifiedObjects = ransacEstimator->GetNumberOfVerifiedObjects();
+  std::cout << "Preemptive: " << verifiedObjects << " objects checked, " << iterations * agreeData.size()
+            << " for full scoring" << std::endl;
+  if (verifiedObjects > 2 * iterations * blockSize || verifiedObjects >= iterations * agreeData.size())
+  {
+    std::cerr << "Preemptive scoring checked too many objects." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+#include <random>
+#include <cmath>
+
+
+/**
+ * Compares uniform sampling with PROSAC. The quality of each putative match
+ * is its residual under the model found by uniform sampling, perturbed by
+ * noise, standing in for a descriptor distance. PROSAC must find a model
+ * with at least the same support using fewer hypotheses.
+ */
+int
+itkRansacTest_ProgressiveSampling(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+  typedef itk::RANSAC<itk::Point<double, DimensionPoint>, double, TTransform> RANSACType;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+  std::vector<double>                             transformParameters;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 20000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  double inlierRatio[2];
+  size_t iterations[2];
+  for (unsigned int useProsac = 0; useProsac < 2; ++useProsac)
+  {
+    if (useProsac)
+    {
+      // larger quality for smaller residuals
+      itk::LandmarkRegistrationEstimator<6, TTransform>::TransformKernel kernel;
+      itk::LandmarkRegistrationEstimator<6, TTransform>::ComputeTransformKernel(transformParameters, kernel);
+      std::mt19937                     generator(0);
+      std::normal_distribution<double> noise(0.0, 1.0);
+      std::vector<double>              quality(data.size());
+      for (unsigned int i = 0; i < data.size(); ++i)
+      {
+        double transformedPoint[3];
+        kernel.TransformPoint(data[i].GetDataPointer(), transformedPoint);
+        double residual = 0.0;
+        for (unsigned int k = 0; k < 3; ++k)
+          residual += (transformedPoint[k] - data[i][k + 3]) * (transformedPoint[k] - data[i][k + 3]);
+        quality[i] = -std::sqrt(residual) + noise(generator);
+      }
+      ransacEstimator->SetSamplingStrategy(RANSACType::SamplingStrategy::PROSAC);
+      ransacEstimator->SetDataQuality(quality);
+    }
+
+    itk::TimeProbe clock;
+    clock.Start();
+    auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    if (transformParameters.empty())
+    {
+      std::cerr << "RANSAC estimate failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+    inlierRatio[useProsac] = result[0];
+    iterations[useProsac] = ransacEstimator->GetNumberOfIterations();
+
+    std::cout << (useProsac ? "PROSAC" : "Uniform") << " sampling: " << iterations[useProsac]
+              << " iterations in " << clock.GetTotal() << " s, inlier ratio " << result[0] << std::endl;
+  }
+
+  if (inlierRatio[1] < inlierRatio[0])
+  {
+    std::cerr << "PROSAC found a worse model." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (iterations[1] >= iterations[0])
+  {
+    std::cerr << "PROSAC did not reduce the number of hypotheses." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkSubSetSampler.h"
+
+
+/**
+ * Reproducibility of the counter based random streams. With one thread and
+ * an iteration budget the adaptive bound never reaches, two runs with the
+ * same seed must estimate the same parameters. The subsets of the first
+ * hypotheses, drawn from the streams of two different seeds as RANSAC draws
+ * them, must differ.
+ */
+int
+itkRansacTest_RandomSeed(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfInliers = 100;
+  const unsigned int             numberOfOutliers = 400;
+  const RansacTestHelper::Motion motion = { -0.4, { 10.0, 20.0, -5.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.05, 11);
+
+  // 20% inliers, the bound for the desired probability is above the budget
+  // and every run draws maxIteration hypotheses
+  double       inlierValue = 0.5;
+  unsigned int maxIteration = 1000;
+  double       desiredProbabilityForNoOutliers = 1.0 - 1e-12;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetNumberOfThreads(1);
+
+  const uint64_t      seeds[2] = { 42, 43 };
+  std::vector<double> firstParameters;
+  std::vector<double> secondParameters;
+  ransacEstimator->SetRandomSeed(seeds[0]);
+  ransacEstimator->Compute(firstParameters, desiredProbabilityForNoOutliers);
+  ransacEstimator->Compute(secondParameters, desiredProbabilityForNoOutliers);
+  std::cout << "Seed " << seeds[0] << ": " << ransacEstimator->GetNumberOfIterations() << " iterations" << std::endl;
+  if (ransacEstimator->GetNumberOfIterations() != maxIteration)
+  {
+    std::cerr << "Expected " << maxIteration << " iterations." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (firstParameters.empty() || firstParameters != secondParameters)
+  {
+    std::cerr << "Two runs with the same seed differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the subsets of the hypotheses for both seeds, a stream per hypothesis
+  const unsigned int                numForEstimate = registrationEstimator->GetMinimalForEstimate();
+  itk::SubSetSampler                sampler;
+  CounterBasedRandomNumberGenerator randomGenerator;
+  std::vector<unsigned int>         subSets[2];
+  sampler.Initialize(numForEstimate);
+  for (unsigned int s = 0; s < 2; ++s)
+  {
+    subSets[s].resize(maxIteration * numForEstimate);
+    for (unsigned int i = 0; i < maxIteration; ++i)
+    {
+      randomGenerator.reset(seeds[s], i);
+      sampler.SampleSorted(randomGenerator, data.size(), numForEstimate, &subSets[s][i * numForEstimate]);
+    }
+  }
+  unsigned int sameSubSets = 0;
+  for (unsigned int i = 0; i < maxIteration; ++i)
+  {
+    if (std::equal(&subSets[0][i * numForEstimate],
+                   &subSets[0][i * numForEstimate] + numForEstimate,
+                   &subSets[1][i * numForEstimate]))
+      sameSubSets++;
+  }
+  std::cout << sameSubSets << " of " << maxIteration << " subsets are the same for seeds " << seeds[0] << " and "
+            << seeds[1] << std::endl;
+  if (sameSubSets > 0)
+  {
+    std::cerr << "Different seeds draw the same subsets." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // and the run with the other seed is reproducible as well
+  ransacEstimator->SetRandomSeed(seeds[1]);
+  ransacEstimator->Compute(firstParameters, desiredProbabilityForNoOutliers);
+  ransacEstimator->Compute(secondParameters, desiredProbabilityForNoOutliers);
+  if (firstParameters.empty() || firstParameters != secondParameters)
+  {
+    std::cerr << "Two runs with the same seed differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
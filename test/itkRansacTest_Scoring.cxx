@@ -0,0 +1,128 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+
+
+/**
+ * Runs RANSAC with the inlier count, MSAC and MLESAC scores. Every method
+ * must find a model, the estimator must score the models with the distances
+ * to the nearest fixed points found by a brute force search, and the model
+ * of every method must score at least as well by that method as the model of
+ * the inlier count.
+ */
+int
+itkRansacTest_Scoring(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+  using EstimatorType = itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 20000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  EstimatorType::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  const EstimatorType::ScoringMethod methods[3] = { EstimatorType::ScoringMethod::RANSAC,
+                                                    EstimatorType::ScoringMethod::MSAC,
+                                                    EstimatorType::ScoringMethod::MLESAC };
+  const char *                       names[3] = { "RANSAC", "MSAC", "MLESAC" };
+  std::vector<double>                parameters[3];
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    registrationEstimator->SetScoringMethod(methods[k]);
+
+    itk::TimeProbe clock;
+    clock.Start();
+    auto result = ransacEstimator->Compute(parameters[k], desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    if (parameters[k].empty() || result[0] <= 0.0)
+    {
+      std::cerr << names[k] << " estimate failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << names[k] << " scoring: " << ransacEstimator->GetNumberOfIterations() << " iterations in "
+              << clock.GetTotal() << " s, inlier ratio " << result[0] << std::endl;
+  }
+
+  // score[k][j], the score of the model of method k by method j
+  const double deltaSquared = inlierValue * inlierValue;
+  const double tolerance = 1e-9 * agreeData.size();
+  double       score[3][3];
+  for (unsigned int k = 0; k < 3; ++k)
+  {
+    auto transform = RansacTestHelper::CreateTransform<TTransform>(parameters[k]);
+
+    // squared distance of every transformed point to the nearest fixed point
+    std::vector<double> nearest(agreeData.size());
+    for (unsigned int i = 0; i < agreeData.size(); ++i)
+    {
+      TTransform::InputPointType point;
+      for (unsigned int d = 0; d < 3; ++d)
+        point[d] = agreeData[i][d];
+      RansacTestHelper::FindNearestMovingPoint(agreeData, transform->TransformPoint(point), nearest[i]);
+    }
+
+    for (unsigned int j = 0; j < 3; ++j)
+    {
+      itk::InlierScoringPolicy policy(methods[j], deltaSquared);
+      double                   expected = 0.0;
+      for (double distance : nearest)
+      {
+        if (distance < deltaSquared)
+          expected += policy(distance);
+      }
+
+      registrationEstimator->SetScoringMethod(methods[j]);
+      double residual = 0.0;
+      score[k][j] = registrationEstimator->AgreeBlock(parameters[k], agreeData, 0, agreeData.size(), residual);
+      if (std::abs(score[k][j] - expected) > tolerance)
+      {
+        std::cerr << names[j] << " score " << score[k][j] << " of the " << names[k]
+                  << " model differs from the brute force score " << expected << "." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+    std::cout << names[k] << " model scores: " << score[k][0] << " inliers, MSAC " << score[k][1] << ", MLESAC "
+              << score[k][2] << std::endl;
+  }
+
+  for (unsigned int k = 1; k < 3; ++k)
+  {
+    if (score[k][k] < score[0][k] - tolerance)
+    {
+      std::cerr << "The " << names[k] << " model scores worse by " << names[k] << " than the inlier count model."
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include "itkTimeProbe.h"
+
+
+/**
+ * Runs RANSAC with and without the sequential probability ratio test. The
+ * test must find an equally good model while checking only a fraction of
+ * the agree data per hypothesis.
+ */
+int
+itkRansacTest_SequentialProbabilityRatioTest(int argc, char * argv[])
+{
+  if (!RansacTestHelper::CheckMeshArguments(argc, argv))
+    return EXIT_FAILURE;
+
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  std::vector<itk::Point<double, DimensionPoint>> data;
+  std::vector<itk::Point<double, DimensionPoint>> agreeData;
+  std::vector<double>                             transformParameters;
+
+  RansacTestHelper::GenerateData<DimensionPoint>(data, agreeData, argv[1], argv[2], argv[3], argv[4]);
+
+  double       inlierValue = 1.5;
+  unsigned int maxIteration = 20000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, agreeData, inlierValue, maxIteration, registrationEstimator);
+
+  double inlierRatio[2];
+  for (unsigned int useTest = 0; useTest < 2; ++useTest)
+  {
+    ransacEstimator->SetUseSequentialProbabilityRatioTest(useTest == 1);
+
+    itk::TimeProbe clock;
+    clock.Start();
+    auto result = ransacEstimator->Compute(transformParameters, desiredProbabilityForNoOutliers);
+    clock.Stop();
+
+    if (transformParameters.empty())
+    {
+      std::cerr << "RANSAC estimate failed." << std::endl;
+      return EXIT_FAILURE;
+    }
+    inlierRatio[useTest] = result[0];
+
+    std::cout << (useTest ? "With" : "Without") << " SPRT: " << ransacEstimator->GetNumberOfIterations()
+              << " iterations in " << clock.GetTotal() << " s, inlier ratio " << result[0] << std::endl;
+  }
+
+  size_t iterations = ransacEstimator->GetNumberOfIterations();
+  double verifiedPerHypothesis = (double)ransacEstimator->GetNumberOfVerifiedObjects() / (double)iterations;
+  std::cout << "Rejected " << ransacEstimator->GetNumberOfRejectedHypotheses() << " hypotheses, checked "
+            << verifiedPerHypothesis << " of " << agreeData.size() << " agree objects per hypothesis" << std::endl;
+
+  if (inlierRatio[1] < 0.9 * inlierRatio[0])
+  {
+    std::cerr << "The sequential test rejected the good models." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (verifiedPerHypothesis > 0.5 * agreeData.size())
+  {
+    std::cerr << "The sequential test did not reduce the verification cost." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
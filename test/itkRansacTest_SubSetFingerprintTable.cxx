@@ -0,0 +1,114 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSubSetFingerprintTable.h"
+#include <vector>
+#include <iostream>
+
+
+/**
+ * Inserts all the 3-subsets of a small set of indexes into the fingerprint
+ * table, with exact fingerprints for few data objects and hashed ones for
+ * many. Every subset must be new on the first insertion and a duplicate on
+ * the second, also across the growth of the table. With a small bound the
+ * table must stop recording once it is full and then report every subset
+ * as new. A large bound must not be allocated up front.
+ */
+int
+itkRansacTest_SubSetFingerprintTable(int, char *[])
+{
+  // all the 3-subsets of 0..n-1, spread over a larger index range
+  const unsigned int        n = 60;
+  const unsigned int        spread = 1000;
+  std::vector<unsigned int> subSets;
+  for (unsigned int i = 0; i < n; ++i)
+    for (unsigned int j = i + 1; j < n; ++j)
+      for (unsigned int k = j + 1; k < n; ++k)
+      {
+        subSets.push_back(i * spread);
+        subSets.push_back(j * spread);
+        subSets.push_back(k * spread);
+      }
+  const size_t numberOfSubSets = subSets.size() / 3;
+
+  itk::SubSetFingerprintTable table;
+
+  // three indexes into 60000 objects fit into 63 bits, into 2^22 they do not
+  const size_t numberOfObjects[2] = { n * spread, static_cast<size_t>(1) << 22 };
+  for (unsigned int e = 0; e < 2; ++e)
+  {
+    table.Initialize(numberOfSubSets, 3, numberOfObjects[e]);
+    if (table.IsExact() != (e == 0))
+    {
+      std::cerr << "Expected " << (e == 0 ? "exact" : "hashed") << " fingerprints for " << numberOfObjects[e]
+                << " objects." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    size_t newSubSets = 0;
+    size_t duplicates = 0;
+    for (size_t s = 0; s < numberOfSubSets; ++s)
+      newSubSets += table.Insert(&subSets[3 * s]) ? 1 : 0;
+    for (size_t s = 0; s < numberOfSubSets; ++s)
+      duplicates += table.Insert(&subSets[3 * s]) ? 0 : 1;
+
+    std::cout << (table.IsExact() ? "Exact" : "Hashed") << " fingerprints: " << newSubSets << " new and "
+              << duplicates << " duplicate subsets of " << numberOfSubSets << ", " << table.GetNumberOfSlots()
+              << " slots" << std::endl;
+    if (newSubSets != numberOfSubSets || duplicates != numberOfSubSets ||
+        table.GetNumberOfSubSets() != numberOfSubSets)
+    {
+      std::cerr << "The table did not detect the duplicates." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // a bound far below the number of subsets, the first ones drawn are
+  // recorded until the levels are half full
+  table.Initialize(100, 3, numberOfObjects[0]);
+  for (size_t s = 0; s < numberOfSubSets; ++s)
+  {
+    if (!table.Insert(&subSets[3 * s]))
+    {
+      std::cerr << "A new subset was reported as a duplicate." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  const size_t recorded = table.GetNumberOfSubSets();
+  size_t       duplicates = 0;
+  for (size_t s = 0; s < numberOfSubSets; ++s)
+    duplicates += table.Insert(&subSets[3 * s]) ? 0 : 1;
+  std::cout << "Bound of 100: " << recorded << " subsets recorded, " << duplicates << " duplicates found"
+            << std::endl;
+  if (recorded < 100 || recorded >= numberOfSubSets || duplicates != recorded ||
+      table.GetNumberOfSubSets() != recorded)
+  {
+    std::cerr << "The full table did not stop recording." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // the default bound of RANSAC, only the first level is allocated
+  table.Initialize(static_cast<size_t>(1) << 32, 3, numberOfObjects[0]);
+  const size_t initialSlots = table.GetNumberOfSlots();
+  if (initialSlots > 4096)
+  {
+    std::cerr << "The table allocated " << initialSlots << " slots up front." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkSubSetSampler.h"
+#include <vector>
+#include <bitset>
+#include <random>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+// the indexes are distinct and in [0,n), ascending if sorted is set
+bool
+CheckSubSet(const unsigned int * indexes, unsigned int n, unsigned int k, bool sorted)
+{
+  std::vector<char> drawn(n, 0);
+  for (unsigned int l = 0; l < k; ++l)
+  {
+    if (indexes[l] >= n || drawn[indexes[l]])
+      return false;
+    drawn[indexes[l]] = 1;
+    if (sorted && l > 0 && indexes[l] < indexes[l - 1])
+      return false;
+  }
+  return true;
+}
+
+// Pearson's statistic of the counts against equal frequencies
+double
+ChiSquare(const std::vector<unsigned int> & counts, double expected)
+{
+  double statistic = 0.0;
+  for (unsigned int count : counts)
+    statistic += (count - expected) * (count - expected) / expected;
+  return statistic;
+}
+} // namespace
+
+
+/**
+ * Draws subsets with the linear scan (small subsets) and the hash table
+ * (large subsets) of the sampler: the indexes must be distinct, every subset
+ * of 3 out of 10 must come up about equally often and every index of the
+ * large subsets as well. Compatible subsets drawn from a random
+ * compatibility graph must only hold pairwise compatible objects, one of
+ * them a seed, and a graph without edges gives no subset.
+ */
+int
+itkRansacTest_SubSetSampler(int, char *[])
+{
+  CounterBasedRandomNumberGenerator randomGenerator(1, 0);
+  itk::SubSetSampler                sampler;
+  sampler.Initialize(40);
+
+  // every subset of 3 out of 10 indexes, ranked by the bits they set
+  const unsigned int        smallN = 10;
+  const unsigned int        smallK = 3;
+  const unsigned int        smallDraws = 120000;
+  std::vector<unsigned int> subSetCounts(1 << smallN, 0);
+  unsigned int              indexes[40];
+  for (unsigned int draw = 0; draw < smallDraws; ++draw)
+  {
+    sampler.SampleSorted(randomGenerator, smallN, smallK, indexes);
+    if (!CheckSubSet(indexes, smallN, smallK, true))
+    {
+      std::cerr << "Small subset with repeated or unsorted indexes." << std::endl;
+      return EXIT_FAILURE;
+    }
+    subSetCounts[(1u << indexes[0]) | (1u << indexes[1]) | (1u << indexes[2])]++;
+  }
+  std::vector<unsigned int> drawnSubSets;
+  for (unsigned int bits = 0; bits < subSetCounts.size(); ++bits)
+  {
+    if (std::bitset<smallN>(bits).count() == smallK)
+      drawnSubSets.push_back(subSetCounts[bits]);
+  }
+  // 119 degrees of freedom, the bound is about 6 standard deviations above
+  const double smallStatistic = ChiSquare(drawnSubSets, smallDraws / (double)drawnSubSets.size());
+  std::cout << "Subsets of " << smallK << " out of " << smallN << ": chi-square " << smallStatistic << " for "
+            << drawnSubSets.size() - 1 << " degrees of freedom" << std::endl;
+  if (drawnSubSets.size() != 120 || smallStatistic > 220.0)
+  {
+    std::cerr << "Small subsets are not uniform." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // large subsets go through the hash table
+  const unsigned int        largeN = 100;
+  const unsigned int        largeK = 40;
+  const unsigned int        largeDraws = 20000;
+  std::vector<unsigned int> indexCounts(largeN, 0);
+  for (unsigned int draw = 0; draw < largeDraws; ++draw)
+  {
+    sampler.Sample(randomGenerator, largeN, largeK, indexes);
+    if (!CheckSubSet(indexes, largeN, largeK, false))
+    {
+      std::cerr << "Large subset with repeated indexes." << std::endl;
+      return EXIT_FAILURE;
+    }
+    for (unsigned int l = 0; l < largeK; ++l)
+      indexCounts[indexes[l]]++;
+  }
+  // the counts of one draw are not independent, the statistic is only
+  // close to a chi-square of 99 degrees of freedom
+  const double largeStatistic = ChiSquare(indexCounts, largeDraws * largeK / (double)largeN);
+  std::cout << "Subsets of " << largeK << " out of " << largeN << ": chi-square " << largeStatistic
+            << " over the indexes" << std::endl;
+  if (largeStatistic > 200.0)
+  {
+    std::cerr << "Large subsets are not uniform." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // random symmetric compatibility graph over more than one word per object
+  const unsigned int          numberOfObjects = 150;
+  const size_t                words = (numberOfObjects + 63) / 64;
+  std::vector<uint64_t>       compatible(numberOfObjects * words, 0);
+  std::mt19937                generator(7);
+  std::bernoulli_distribution edge(0.3);
+  auto                        isCompatible = [&](unsigned int i, unsigned int j) {
+    return (compatible[i * words + j / 64] >> (j % 64)) & 1;
+  };
+  for (unsigned int i = 0; i < numberOfObjects; ++i)
+  {
+    for (unsigned int j = i + 1; j < numberOfObjects; ++j)
+    {
+      if (edge(generator))
+      {
+        compatible[i * words + j / 64] |= uint64_t(1) << (j % 64);
+        compatible[j * words + i / 64] |= uint64_t(1) << (i % 64);
+      }
+    }
+  }
+  std::vector<unsigned int> seeds;
+  std::vector<char>         isSeed(numberOfObjects, 0);
+  for (unsigned int i = 0; i < numberOfObjects; i += 3)
+  {
+    seeds.push_back(i);
+    isSeed[i] = 1;
+  }
+
+  const unsigned int compatibleK = 4;
+  unsigned int       compatibleSubSets = 0;
+  for (unsigned int draw = 0; draw < 10000; ++draw)
+  {
+    if (!sampler.SampleCompatible(
+          randomGenerator, compatible.data(), words, seeds.data(), seeds.size(), compatibleK, indexes))
+      continue;
+    compatibleSubSets++;
+    bool hasSeed = false;
+    for (unsigned int l = 0; l < compatibleK; ++l)
+    {
+      hasSeed |= isSeed[indexes[l]] != 0;
+      for (unsigned int m = l + 1; m < compatibleK; ++m)
+      {
+        if (!isCompatible(indexes[l], indexes[m]))
+        {
+          std::cerr << "Compatible subset with incompatible objects " << indexes[l] << " and " << indexes[m] << "."
+                    << std::endl;
+          return EXIT_FAILURE;
+        }
+      }
+    }
+    if (!CheckSubSet(indexes, numberOfObjects, compatibleK, true) || !hasSeed)
+    {
+      std::cerr << "Compatible subset with repeated indexes or without a seed." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::cout << compatibleSubSets << " compatible subsets of " << compatibleK << " drawn" << std::endl;
+  if (compatibleSubSets == 0)
+  {
+    std::cerr << "No compatible subset drawn." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint64_t> incompatible(numberOfObjects * words, 0);
+  if (sampler.SampleCompatible(
+        randomGenerator, incompatible.data(), words, seeds.data(), seeds.size(), compatibleK, indexes))
+  {
+    std::cerr << "Compatible subset drawn without any compatible pair." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
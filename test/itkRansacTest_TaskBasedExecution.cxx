@@ -0,0 +1,82 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkRansacTestHelper.h"
+#include <algorithm>
+
+
+/**
+ * A low inlier ratio keeps the adaptive number of tries above the budget,
+ * so every iteration is run. Then the hypotheses run as tasks must give
+ * exactly the model of the threads sharing a global budget, for the same
+ * seed, since a hypothesis depends only on its iteration number.
+ */
+int
+itkRansacTest_TaskBasedExecution(int, char *[])
+{
+  using TTransform = itk::Similarity3DTransform<double>;
+  const unsigned int DimensionPoint = RansacTestHelper::DimensionPoint;
+
+  const unsigned int             numberOfInliers = 60;
+  const unsigned int             numberOfOutliers = 540;
+  const RansacTestHelper::Motion motion = { -0.4, { 3.0, 0.0, -8.0 } };
+
+  std::vector<itk::Point<double, DimensionPoint>> data =
+    RansacTestHelper::GenerateMotionData(numberOfInliers, numberOfOutliers, 100.0, motion, 0.01, 17);
+
+  double       inlierValue = 0.1;
+  unsigned int maxIteration = 2000;
+  double       desiredProbabilityForNoOutliers = 0.99;
+
+  itk::LandmarkRegistrationEstimator<DimensionPoint, TTransform>::Pointer registrationEstimator;
+  auto ransacEstimator = RansacTestHelper::CreateRegistrationRANSAC<TTransform>(
+    data, data, inlierValue, maxIteration, registrationEstimator);
+  ransacEstimator->SetNumberOfThreads(std::min(4u, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads()));
+  ransacEstimator->SetUseGlobalIterationBudget(true);
+  ransacEstimator->SetRandomSeed(3);
+
+  std::vector<double> parameters[2];
+  double              inlierRatio[2];
+  for (unsigned int k = 0; k < 2; ++k)
+  {
+    ransacEstimator->SetUseTaskBasedExecution(k == 1);
+    auto result = ransacEstimator->Compute(parameters[k], desiredProbabilityForNoOutliers);
+    inlierRatio[k] = parameters[k].empty() ? 0.0 : result[0];
+    std::cout << (k == 1 ? "Tasks: " : "Threads: ") << ransacEstimator->GetNumberOfIterations()
+              << " iterations, inlier ratio " << inlierRatio[k] << std::endl;
+
+    if (ransacEstimator->GetNumberOfIterations() != maxIteration)
+    {
+      std::cerr << "Expected " << maxIteration << " iterations." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (parameters[0] != parameters[1])
+  {
+    std::cerr << "The tasks found another model than the threads." << std::endl;
+    return EXIT_FAILURE;
+  }
+  const double expectedRatio = numberOfInliers / (double)data.size();
+  if (inlierRatio[1] < 0.99 * expectedRatio)
+  {
+    std::cerr << "The motion was not found." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*=========================================================================
+ *
+ *  Copyright NumFOCUS
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *         https://www.apache.org/licenses/LICENSE-2.0.txt
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *=========================================================================*/
+
+#include "itkAffineTransformKernel.h"
+#include "itkTimeProbe.h"
+#include <vector>
+#include <random>
+#include <cmath>
+#include <iostream>
+
+
+/**
+ * Compares the batched (SIMD) transform of the affine kernel with the per
+ * point one on 6D correspondences and reports the time per point of both.
+ */
+int
+itkRansacTest_TransformKernel(int, char *[])
+{
+  const unsigned int DimensionPoint = 6;
+  const size_t       numberOfPoints = 100003; // not a multiple of the batch width
+  const unsigned int repetitions = 20;
+
+  std::mt19937                           generator(42);
+  std::uniform_real_distribution<double> distribution(-100.0, 100.0);
+
+  std::vector<double> points(numberOfPoints * DimensionPoint);
+  for (auto & coordinate : points)
+    coordinate = distribution(generator);
+
+  itk::AffineTransformKernel kernel;
+  for (unsigned int r = 0; r < 3; ++r)
+  {
+    for (unsigned int c = 0; c < 3; ++c)
+      kernel.matrix[r][c] = distribution(generator) / 100.0;
+    kernel.offset[r] = distribution(generator);
+  }
+
+  std::vector<double> x(numberOfPoints), y(numberOfPoints), z(numberOfPoints);
+  std::vector<double> reference(3 * numberOfPoints);
+
+  itk::TimeProbe batchedClock;
+  itk::TimeProbe scalarClock;
+  for (unsigned int k = 0; k < repetitions; ++k)
+  {
+    batchedClock.Start();
+    kernel.TransformPoints(points.data(), DimensionPoint, numberOfPoints, x.data(), y.data(), z.data());
+    batchedClock.Stop();
+
+    scalarClock.Start();
+    for (size_t i = 0; i < numberOfPoints; ++i)
+      kernel.TransformPoint(points.data() + i * DimensionPoint, reference.data() + 3 * i);
+    scalarClock.Stop();
+  }
+
+  // the SIMD paths use fused multiply-adds, allow for the rounding difference
+  double maxError = 0.0;
+  for (size_t i = 0; i < numberOfPoints; ++i)
+  {
+    maxError = std::max(maxError, std::abs(x[i] - reference[3 * i]));
+    maxError = std::max(maxError, std::abs(y[i] - reference[3 * i + 1]));
+    maxError = std::max(maxError, std::abs(z[i] - reference[3 * i + 2]));
+  }
+
+  const double pointsTransformed = static_cast<double>(numberOfPoints) * repetitions;
+  std::cout << "Batch width: " << itk::AffineTransformKernel::BatchWidth << std::endl;
+  std::cout << "Batched:   " << 1e9 * batchedClock.GetTotal() / pointsTransformed << " ns/point" << std::endl;
+  std::cout << "Per point: " << 1e9 * scalarClock.GetTotal() / pointsTransformed << " ns/point" << std::endl;
+  std::cout << "Max error: " << maxError << std::endl;
+
+  if (maxError > 1e-10)
+  {
+    std::cerr << "Batched and per point transforms differ." << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}